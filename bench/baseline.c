@@ -0,0 +1,263 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+// C-level loops equivalent to the lua benchmarks to get the baseline of the
+// binding overhead. the results are emitted as JSON lines.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// same as the default per-wait cap of the binding
+#define MAXEVENTS 1024
+
+static double duration = 1;
+
+static double getclock(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000;
+}
+
+static void skip(const char *name, int n, const char *reason)
+{
+    printf("{\"bench\":\"%s\",\"impl\":\"c\",\"nfd\":%d,\"reason\":\"%s\","
+           "\"skipped\":true}\n",
+           name, n, reason);
+    fflush(stdout);
+}
+
+// create n sockets. it returns NULL if the descriptors are exhausted.
+// NOTE: if n is odd, the peer of the last socket is kept open at fds[n] not
+// to make the socket hung up.
+static int *sockets(int n)
+{
+    int *fds = malloc(sizeof(int) * (n + 1));
+
+    if (!fds) {
+        return NULL;
+    }
+    for (int i = 0; i < n; i += 2) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds + i) == -1) {
+            int err = errno;
+            for (int j = 0; j < i; j++) {
+                close(fds[j]);
+            }
+            free(fds);
+            errno = err;
+            return NULL;
+        }
+    }
+    return fds;
+}
+
+static void closeall(int *fds, int n)
+{
+    // close the peer of the last socket as well
+    for (int i = 0; i < n + n % 2; i++) {
+        close(fds[i]);
+    }
+    free(fds);
+}
+
+static void wait_consume(int nfd)
+{
+    int *fds = sockets(nfd);
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event evs[MAXEVENTS];
+
+    if (!fds || epfd == -1) {
+        skip("wait_consume", nfd, strerror(errno));
+        if (fds) {
+            closeall(fds, nfd);
+        }
+        if (epfd != -1) {
+            close(epfd);
+        }
+        return;
+    }
+    for (int i = 0; i < nfd; i++) {
+        struct epoll_event evt = {
+            .events  = EPOLLOUT,
+            .data.fd = fds[i],
+        };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &evt);
+    }
+
+    uint64_t nwait  = 0;
+    uint64_t nevt   = 0;
+    uint64_t sum    = 0;
+    double t        = getclock();
+    double deadline = t + duration;
+    do {
+        int maxevents = (nfd < MAXEVENTS) ? nfd : MAXEVENTS;
+        int n         = epoll_wait(epfd, evs, maxevents, 0);
+        if (n <= 0) {
+            // NOTE: every wait must report the events, otherwise the
+            // results cannot be compared with the binding
+            fprintf(stderr, "wait_consume: no events reported\n");
+            exit(EXIT_FAILURE);
+        }
+        nwait++;
+        for (int i = 0; i < n; i++) {
+            // touch the event as the binding does
+            sum += (uint64_t)evs[i].data.fd;
+        }
+        nevt += (uint64_t)n;
+    } while (getclock() < deadline);
+    double elapsed = getclock() - t;
+
+    printf("{\"bench\":\"wait_consume\",\"elapsed\":%.9g,\"events\":%llu,"
+           "\"events_per_sec\":%.9g,\"events_per_wait\":%.9g,"
+           "\"impl\":\"c\",\"nfd\":%d,\"waits\":%llu,"
+           "\"waits_per_sec\":%.9g}\n",
+           elapsed, (unsigned long long)nevt, (double)nevt / elapsed,
+           (double)nevt / (double)nwait, nfd, (unsigned long long)nwait,
+           (double)nwait / elapsed);
+    fflush(stdout);
+    (void)sum;
+    close(epfd);
+    closeall(fds, nfd);
+}
+
+static void churn(int nfd)
+{
+    int *fds = sockets(nfd);
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (!fds || epfd == -1) {
+        skip("churn", nfd, strerror(errno));
+        if (fds) {
+            closeall(fds, nfd);
+        }
+        if (epfd != -1) {
+            close(epfd);
+        }
+        return;
+    }
+
+    // register and unregister the read events by turns
+    uint64_t nop    = 0;
+    double t        = getclock();
+    double deadline = t + duration;
+    do {
+        for (int i = 0; i < nfd; i++) {
+            struct epoll_event evt = {
+                .events  = EPOLLIN,
+                .data.fd = fds[i],
+            };
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &evt);
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fds[i], NULL);
+        }
+        nop += (uint64_t)nfd;
+    } while (getclock() < deadline);
+    double elapsed = getclock() - t;
+
+    printf("{\"bench\":\"churn\",\"elapsed\":%.9g,\"impl\":\"c\",\"nfd\":%d,"
+           "\"ops\":%llu,\"ops_per_sec\":%.9g}\n",
+           elapsed, nfd, (unsigned long long)nop, (double)nop / elapsed);
+    fflush(stdout);
+    close(epfd);
+    closeall(fds, nfd);
+}
+
+static int pingpong(int epfd, int efd)
+{
+    struct epoll_event evt = {0};
+    uint64_t val           = 1;
+
+    if (write(efd, &val, sizeof(val)) == -1 ||
+        epoll_wait(epfd, &evt, 1, -1) != 1 || evt.data.fd != efd ||
+        read(efd, &val, sizeof(val)) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+static void trigger(void)
+{
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int ping = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int pong = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (epfd == -1 || ping == -1 || pong == -1) {
+        skip("trigger", 0, strerror(errno));
+        return;
+    }
+    struct epoll_event evt = {
+        .events  = EPOLLIN,
+        .data.fd = ping,
+    };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, ping, &evt);
+    evt.data.fd = pong;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, pong, &evt);
+
+    uint64_t nround = 0;
+    double t        = getclock();
+    double deadline = t + duration;
+    do {
+        if (pingpong(epfd, ping) == -1 || pingpong(epfd, pong) == -1) {
+            perror("trigger");
+            exit(EXIT_FAILURE);
+        }
+        nround++;
+    } while (getclock() < deadline);
+    double elapsed = getclock() - t;
+
+    printf("{\"bench\":\"trigger\",\"elapsed\":%.9g,\"impl\":\"c\","
+           "\"latency_usec\":%.9g,\"rounds\":%llu,\"rounds_per_sec\":%.9g}\n",
+           elapsed, elapsed / (double)(nround * 2) * 1000000,
+           (unsigned long long)nround, (double)nround / elapsed);
+    fflush(stdout);
+    close(ping);
+    close(pong);
+    close(epfd);
+}
+
+int main(void)
+{
+    static const int wait_sizes[]  = {1, 1000, 100000, 1000000};
+    static const int churn_sizes[] = {1, 1000};
+    const char *env                = getenv("BENCH_DURATION");
+
+    if (env && atof(env) > 0) {
+        duration = atof(env);
+    }
+
+    for (size_t i = 0; i < sizeof(wait_sizes) / sizeof(int); i++) {
+        wait_consume(wait_sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(churn_sizes) / sizeof(int); i++) {
+        churn(churn_sizes[i]);
+    }
+    trigger();
+
+    return EXIT_SUCCESS;
+}
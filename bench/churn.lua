@@ -0,0 +1,55 @@
+--
+-- registration churn rate through ev:as_read() and ev:unwatch().
+--
+local epoll = require('epoll')
+local bench = require('bench.common')
+
+local NAME = 'churn'
+
+local function run(nfd)
+    local socks, err = bench.sockets(nfd)
+    if not socks then
+        return bench.skip(NAME, {
+            nfd = nfd,
+        }, tostring(err))
+    end
+
+    local ep = assert(epoll.new({
+        capacity = nfd,
+    }))
+    local evs = {}
+    for i = 1, nfd do
+        evs[i] = ep:new_event()
+    end
+
+    -- register and unregister the read events by turns
+    local nop = 0
+    local t = bench.clock()
+    local deadline = t + bench.DURATION
+    repeat
+        for i = 1, nfd do
+            local ev = evs[i]
+            assert(ev:as_read(socks[i]:fd()))
+            assert(ev:unwatch())
+            assert(ev:revert())
+        end
+        nop = nop + nfd
+    until bench.clock() >= deadline
+    local elapsed = bench.clock() - t
+
+    bench.emit(NAME, {
+        nfd = nfd,
+        ops = nop,
+        elapsed = elapsed,
+        ops_per_sec = nop / elapsed,
+    })
+
+    bench.close(socks)
+end
+
+for _, nfd in ipairs(bench.sizes('BENCH_CHURN_SIZES', {
+    1,
+    1000,
+})) do
+    run(nfd)
+end
@@ -0,0 +1,160 @@
+--
+-- common helpers of the benchmark scripts.
+--
+-- each benchmark emits its results as JSON lines to stdout so that the
+-- results of different builds can be compared by the external tools.
+--
+local epoll = require('epoll')
+local socketpair = require('testcase.socketpair')
+local concat = table.concat
+local format = string.format
+local sort = table.sort
+
+--- duration of each benchmark in seconds
+local DURATION = tonumber(os.getenv('BENCH_DURATION')) or 1
+
+--- encode a scalar value as JSON
+--- @param v any
+--- @return string
+local function encode(v)
+    local t = type(v)
+    if t == 'number' then
+        if v ~= v or v == math.huge or v == -math.huge then
+            return 'null'
+        elseif v == math.floor(v) and math.abs(v) < 2 ^ 53 then
+            return format('%d', v)
+        end
+        return format('%.9g', v)
+    elseif t == 'boolean' then
+        return tostring(v)
+    elseif t == 'nil' then
+        return 'null'
+    end
+    return (format('%q', tostring(v)):gsub('\\\n', '\\n'))
+end
+
+--- emit a result record as a JSON line
+--- @param name string
+--- @param rec table
+local function emit(name, rec)
+    rec.bench = name
+    rec.impl = 'lua'
+    rec.lua = _VERSION
+    if type(jit) == 'table' then
+        rec.lua = jit.version
+    end
+
+    local keys = {}
+    for k in pairs(rec) do
+        keys[#keys + 1] = k
+    end
+    sort(keys)
+    local list = {}
+    for i, k in ipairs(keys) do
+        list[i] = format('%q:%s', k, encode(rec[k]))
+    end
+    io.stdout:write('{', concat(list, ','), '}\n')
+    io.stdout:flush()
+end
+
+--- emit a record that the benchmark was skipped
+--- @param name string
+--- @param rec table
+--- @param reason string
+local function skip(name, rec, reason)
+    rec.skipped = true
+    rec.reason = reason
+    emit(name, rec)
+end
+
+--- create n sockets. it returns nil if the descriptors are exhausted.
+--- NOTE: if n is odd, the peer of the last socket is kept open in the peer
+--- field not to make the socket hung up.
+--- @param n integer
+--- @return table? socks
+--- @return any err
+local function sockets(n)
+    local socks = {}
+    while #socks < n do
+        local s1, s2, err = socketpair()
+        if not s1 then
+            for _, sock in ipairs(socks) do
+                sock:close()
+            end
+            return nil, err or s2
+        end
+        socks[#socks + 1] = s1
+        if #socks < n then
+            socks[#socks + 1] = s2
+        else
+            socks.peer = s2
+        end
+    end
+    return socks
+end
+
+--- close the sockets
+--- @param socks table
+local function close(socks)
+    for _, sock in ipairs(socks) do
+        sock:close()
+    end
+    if socks.peer then
+        socks.peer:close()
+    end
+end
+
+--- get the lowest unused descriptor number
+--- @return integer
+local function nextfd()
+    local s1, s2 = assert(socketpair())
+    local fd = s1:fd()
+    s1:close()
+    s2:close()
+    return fd
+end
+
+--- get the memory usage in kilobytes
+--- @return number lua memory usage of the lua state
+--- @return number rss resident set size of the process
+local function memusage()
+    collectgarbage('collect')
+    collectgarbage('collect')
+    local rss = 0
+    local f = io.open('/proc/self/statm')
+    if f then
+        local pages = f:read('*a'):match('^%d+%s+(%d+)')
+        f:close()
+        -- NOTE: assume that the page size is 4 KiB
+        rss = (tonumber(pages) or 0) * 4
+    end
+    return collectgarbage('count'), rss
+end
+
+--- get the list of the sizes from the environment variable
+--- @param name string
+--- @param default integer[]
+--- @return integer[]
+local function sizes(name, default)
+    local v = os.getenv(name)
+    if not v then
+        return default
+    end
+    local list = {}
+    for n in v:gmatch('%d+') do
+        list[#list + 1] = tonumber(n)
+    end
+    return list
+end
+
+return {
+    DURATION = DURATION,
+    clock = epoll.clock,
+    emit = emit,
+    skip = skip,
+    sockets = sockets,
+    close = close,
+    nextfd = nextfd,
+    memusage = memusage,
+    sizes = sizes,
+}
@@ -0,0 +1,54 @@
+--
+-- memory and descriptor usage per registered event.
+--
+local epoll = require('epoll')
+local bench = require('bench.common')
+
+local NAME = 'footprint'
+local N = tonumber(os.getenv('BENCH_FOOTPRINT_SIZE')) or 10000
+
+local function run(filter, register)
+    local socks, err = {}, nil
+    if filter == 'read' then
+        socks, err = bench.sockets(N)
+    end
+    if not socks then
+        return bench.skip(NAME, {
+            filter = filter,
+            n = N,
+        }, tostring(err))
+    end
+
+    local ep = assert(epoll.new())
+    local evs = {}
+    local fd = bench.nextfd()
+    local mem, rss = bench.memusage()
+    for i = 1, N do
+        evs[i] = ep:new_event()
+        assert(register(evs[i], i, socks[i]))
+    end
+    local mem2, rss2 = bench.memusage()
+
+    bench.emit(NAME, {
+        filter = filter,
+        n = N,
+        lua_bytes_per_event = (mem2 - mem) * 1024 / N,
+        rss_bytes_per_event = (rss2 - rss) * 1024 / N,
+        fds_per_event = (bench.nextfd() - fd) / N,
+    })
+
+    for i = 1, N do
+        evs[i]:revert()
+    end
+    bench.close(socks)
+end
+
+run('read', function(ev, _, sock)
+    return ev:as_read(sock:fd())
+end)
+run('timer', function(ev, i)
+    return ev:as_timer(i, 60)
+end)
+run('trigger', function(ev)
+    return ev:as_trigger()
+end)
@@ -0,0 +1,30 @@
+#!/usr/bin/env sh
+#
+# run all benchmarks and print the results as JSON lines.
+#
+#   usage: ./bench/run.sh [lua-command] > results.jsonl
+#
+# BENCH_DURATION sets the duration of each benchmark in seconds, and
+# BENCH_SIZES, BENCH_CHURN_SIZES and BENCH_TIMER_SIZES set the comma
+# separated list of the number of events. the benchmarks that need more
+# descriptors than RLIMIT_NOFILE are reported as skipped.
+#
+
+set -e
+
+LUA=${1:-lua}
+CC=${CC:-cc}
+cd "$(dirname "$0")/.."
+
+# raise the descriptor limit as high as possible for the 1M fds benchmark
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+
+for name in wait_consume churn timer trigger footprint; do
+    "$LUA" "bench/${name}.lua"
+done
+
+# baseline of the equivalent C-level loops
+BASELINE=$(mktemp)
+trap 'rm -f "$BASELINE"' EXIT
+"$CC" -O2 -o "$BASELINE" bench/baseline.c
+"$BASELINE"
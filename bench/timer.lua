@@ -0,0 +1,51 @@
+--
+-- timer creation and expiry throughput through ev:as_timer().
+--
+local epoll = require('epoll')
+local bench = require('bench.common')
+
+local NAME = 'timer'
+
+local function run(ntimer)
+    local ep = assert(epoll.new())
+    local evs = {}
+    for i = 1, ntimer do
+        evs[i] = ep:new_event()
+    end
+
+    -- create timers that expire at every 1 millisecond
+    local t = bench.clock()
+    for i = 1, ntimer do
+        assert(evs[i]:as_timer(i, 0.001))
+    end
+    local create = bench.clock() - t
+
+    -- consume the expired timers
+    local nevt = 0
+    t = bench.clock()
+    local deadline = t + bench.DURATION
+    repeat
+        assert(ep:wait(0.01))
+        while ep:consume() do
+            nevt = nevt + 1
+        end
+    until bench.clock() >= deadline
+    local elapsed = bench.clock() - t
+
+    bench.emit(NAME, {
+        ntimer = ntimer,
+        create_elapsed = create,
+        creates_per_sec = ntimer / create,
+        events = nevt,
+        elapsed = elapsed,
+        events_per_sec = nevt / elapsed,
+    })
+end
+
+for _, ntimer in ipairs(bench.sizes('BENCH_TIMER_SIZES', {
+    1,
+    1000,
+    100000,
+})) do
+    run(ntimer)
+end
@@ -0,0 +1,34 @@
+--
+-- trigger ping-pong latency through ev:as_trigger().
+--
+-- each round trip triggers the event, waits for it and consumes it.
+--
+local epoll = require('epoll')
+local bench = require('bench.common')
+
+local NAME = 'trigger'
+
+local ep = assert(epoll.new())
+local ping = assert(ep:new_event():as_trigger())
+local pong = assert(ep:new_event():as_trigger())
+
+local nround = 0
+local t = bench.clock()
+local deadline = t + bench.DURATION
+repeat
+    assert(ping:trigger())
+    assert(ep:wait())
+    assert(ep:consume() == ping)
+    assert(pong:trigger())
+    assert(ep:wait())
+    assert(ep:consume() == pong)
+    nround = nround + 1
+until bench.clock() >= deadline
+local elapsed = bench.clock() - t
+
+bench.emit(NAME, {
+    rounds = nround,
+    elapsed = elapsed,
+    rounds_per_sec = nround / elapsed,
+    latency_usec = elapsed / (nround * 2) * 1e6,
+})
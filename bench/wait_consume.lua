@@ -0,0 +1,69 @@
+--
+-- events/sec through ep:wait() and ep:consume() with n ready descriptors.
+--
+-- the write events of the sockets are always ready while the send buffer
+-- has space, so every wait returns the ready events up to the maxevents.
+--
+local epoll = require('epoll')
+local bench = require('bench.common')
+
+local NAME = 'wait_consume'
+
+local function run(nfd)
+    local socks, err = bench.sockets(nfd)
+    if not socks then
+        return bench.skip(NAME, {
+            nfd = nfd,
+        }, tostring(err))
+    end
+
+    local ep = assert(epoll.new({
+        capacity = nfd,
+    }))
+    local evs = {}
+    for i = 1, nfd do
+        evs[i] = ep:new_event()
+        assert(evs[i]:as_write(socks[i]:fd()))
+    end
+
+    local nwait = 0
+    local nevt = 0
+    local t = bench.clock()
+    local deadline = t + bench.DURATION
+    repeat
+        -- NOTE: every wait must report the events, otherwise the results
+        -- cannot be compared with the baseline
+        if assert(ep:wait(0)) == 0 then
+            error(NAME .. ': no events reported')
+        end
+        nwait = nwait + 1
+        while ep:consume() do
+            nevt = nevt + 1
+        end
+    until bench.clock() >= deadline
+    local elapsed = bench.clock() - t
+
+    bench.emit(NAME, {
+        nfd = nfd,
+        waits = nwait,
+        events = nevt,
+        elapsed = elapsed,
+        events_per_sec = nevt / elapsed,
+        events_per_wait = nevt / nwait,
+        waits_per_sec = nwait / elapsed,
+    })
+
+    for i = 1, nfd do
+        evs[i]:unwatch()
+    end
+    bench.close(socks)
+end
+
+for _, nfd in ipairs(bench.sizes('BENCH_SIZES', {
+    1,
+    1000,
+    100000,
+    1000000,
+})) do
+    run(nfd)
+end
@@ -18,6 +18,7 @@ for header, funcs in pairs({
         'epoll_create1',
         'epoll_wait',
         'epoll_pwait',
+        'epoll_pwait2',
     },
     ['sys/signalfd.h'] = {
         'signalfd',
@@ -35,6 +36,10 @@ for header, funcs in pairs({
         end
     end
 end
+-- optional io_uring backend
+cfgh:check_header('linux/io_uring.h')
+-- optional busy poll parameters (EPIOCSPARAMS)
+cfgh:check_header('linux/eventpoll.h')
 assert(cfgh:flush('src/config.h'))
 
 -- create symbolic link to src/ directory
@@ -0,0 +1,192 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_epoll.h"
+#include <stdlib.h>
+
+static int changes_grow(poll_t *p)
+{
+    int size               = (p->changesize) ? p->changesize * 2 : 64;
+    int *changes           = realloc(p->changes, sizeof(int) * size);
+    poll_ctlreq_t *chgreqs = NULL;
+
+    if (!changes) {
+        return POLL_ERROR;
+    }
+    p->changes = changes;
+    chgreqs    = realloc(p->chgreqs, sizeof(poll_ctlreq_t) * size);
+    if (!chgreqs) {
+        return POLL_ERROR;
+    }
+    p->chgreqs    = chgreqs;
+    p->changesize = size;
+    return POLL_OK;
+}
+
+// record the request of the fd. the add and modify requests of the same fd
+// are merged into the net change that is applied by poll_changelist_flush().
+int poll_changelist_add(poll_t *p, int op, int fd, event_t *evt)
+{
+    poll_fdslot_t *slot = p->fdset + fd;
+
+    if (op == EPOLL_CTL_DEL) {
+        if (!slot->kreg) {
+            if (slot->changed && slot->reg) {
+                // cancel the registration that has not been applied yet
+                slot->reg = 0;
+                p->nrecord++;
+            }
+            return 0;
+        }
+        // NOTE: the fd may be closed and reused for another file right after
+        // it is unwatched. the kernel keys the registration on the pair of
+        // the file and the fd, so it must be deleted before the fd is closed.
+        slot->reg  = 0;
+        slot->kreg = 0;
+        return poll_ctl(p, EPOLL_CTL_DEL, fd, NULL);
+    }
+
+    if (!slot->changed) {
+        if (p->nchange == p->changesize && changes_grow(p) != POLL_OK) {
+            return -1;
+        }
+        p->changes[p->nchange++] = fd;
+        slot->changed            = 1;
+    }
+    p->nrecord++;
+    slot->reg = 1;
+    slot->evt = *evt;
+    return 0;
+}
+
+// returns true if the event to be registered is the same as the one that is
+// registered with the kernel. the oneshot event must be modified to re-arm.
+static inline int is_unchanged(poll_fdslot_t *slot)
+{
+    return slot->kreg && !(slot->evt.events & EV_ONESHOT) &&
+           slot->evt.events == slot->kevt.events &&
+           slot->evt.data.u64 == slot->kevt.data.u64;
+}
+
+// deliver the error of the deferred registration as the EPOLLERR event
+static int deliver_error(poll_t *p, int fd, int err)
+{
+    poll_event_t *ev = p->fdset[fd].ev;
+
+    if (!ev || !ev->enabled || ev->reg_evt.data.fd != fd) {
+        // event is already unwatched
+        return 0;
+    }
+    // NOTE: poll_pending_add() resets the occurred event, so it must be
+    // set after the event is queued
+    poll_pending_add(p, ev);
+    ev->occ_evt = (event_t){
+        .events = EPOLLERR,
+        .data   = ev->reg_evt.data,
+    };
+    ev->ctl_errno = err;
+    return 1;
+}
+
+// apply the net changes of the recorded requests. the requests are submitted
+// in a batch. it returns the number of the events that failed to be
+// registered. the errors are delivered as the EPOLLERR events.
+int poll_changelist_flush(poll_t *p)
+{
+    poll_ctlreq_t *reqs = p->chgreqs;
+    int nissue          = 0;
+    int nreq            = 0;
+    int nerr            = 0;
+
+    if (p->nchange == 0) {
+        return 0;
+    }
+
+    // add or modify the registrations
+    for (int i = 0; i < p->nchange; i++) {
+        int fd              = p->changes[i];
+        poll_fdslot_t *slot = p->fdset + fd;
+
+        if (slot->reg && !is_unchanged(slot)) {
+            reqs[nreq++] = (poll_ctlreq_t){
+                .op  = (slot->kreg) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                .fd  = fd,
+                .evt = &slot->evt,
+            };
+        }
+        slot->changed = 0;
+    }
+    if (nreq) {
+        poll_ctl_batch(p, reqs, nreq);
+        nissue += nreq;
+    }
+    for (int i = 0; i < nreq; i++) {
+        poll_ctlreq_t *req  = reqs + i;
+        poll_fdslot_t *slot = p->fdset + req->fd;
+
+        if (req->op == EPOLL_CTL_MOD && req->res == -ENOENT) {
+            // NOTE: the registration has been removed by the kernel (e.g. the
+            // fd was closed)
+            req->res = 0;
+            nissue++;
+            if (poll_ctl(p, EPOLL_CTL_ADD, req->fd, req->evt) == -1) {
+                req->res = -errno;
+            }
+            slot->kreg = 0;
+        }
+        if (req->res == 0) {
+            slot->kreg = 1;
+            slot->kevt = slot->evt;
+        } else {
+            nerr += deliver_error(p, req->fd, -req->res);
+        }
+    }
+
+    if (p->nrecord > nissue) {
+        p->stats.nctl_cancel += (uint64_t)(p->nrecord - nissue);
+    }
+    p->nrecord = 0;
+    p->nchange = 0;
+    return nerr;
+}
+
+// discard the recorded requests and the registration state since the kernel
+// registrations are lost when the epoll descriptor is renewed
+void poll_changelist_reset(poll_t *p)
+{
+    for (int i = 0; i < p->fdsize; i++) {
+        p->fdset[i].kreg    = 0;
+        p->fdset[i].changed = 0;
+    }
+    p->nrecord = 0;
+    p->nchange = 0;
+}
+
+void poll_changelist_free(poll_t *p)
+{
+    free(p->changes);
+    free(p->chgreqs);
+    p->changes    = NULL;
+    p->chgreqs    = NULL;
+    p->changesize = 0;
+    p->nchange    = 0;
+}
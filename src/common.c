@@ -21,6 +21,7 @@
  */
 
 #include "lua_epoll.h"
+#include <stdlib.h>
 
 static inline void event_closefd(poll_event_t *ev)
 {
@@ -34,21 +35,41 @@ static inline void event_closefd(poll_event_t *ev)
         }
         break;
 
-    case EVFILT_SIGNAL:
-    case EVFILT_TIMER:
     case EVFILT_TRIGGER:
-        // close signalfd, timerfd, or eventfd
-        close(ev->reg_evt.data.fd);
+        // release eventfd. it is closed when the last handle is released
+        if (ev->trigger) {
+            poll_trigger_release(ev->trigger);
+            ev->trigger = NULL;
+        }
         ev->reg_evt.data.fd = -1;
         break;
     }
 }
 
+static inline void prio_release(poll_event_t *ev)
+{
+    if (ev->prio) {
+        ev->p->nprio--;
+    }
+}
+
+static inline void prio_retain(poll_event_t *ev)
+{
+    if (ev->prio) {
+        ev->p->nprio++;
+    }
+}
+
 int poll_event_gc_lua(lua_State *L)
 {
     poll_event_t *ev = lua_touserdata(L, 1);
+    poll_detach_event(ev);
     unref(L, ev->ref_poll);
+    unref(L, ev->ref_self);
     unref(L, ev->ref_udata);
+    unref(L, ev->ref_co);
+    poll_handler_release(L, ev);
+    prio_release(ev);
     event_closefd(ev);
     return 0;
 }
@@ -79,7 +100,14 @@ int poll_event_renew_lua(lua_State *L, const char *tname)
 
     // replace poll instance
     if (ev->p != p) {
+        // move the counters of the handler and the priority
+        if (ev->ref_handler != LUA_NOREF) {
+            ev->p->nhandler--;
+            p->nhandler++;
+        }
+        prio_release(ev);
         ev->p        = p;
+        prio_retain(ev);
         ev->ref_poll = unref(L, ev->ref_poll);
         lua_settop(L, 2);
         ev->ref_poll = getref(L);
@@ -98,6 +126,7 @@ int poll_event_revert_lua(lua_State *L, const char *tname)
 {
     poll_event_t *ev = luaL_checkudata(L, 1, tname);
 
+    poll_await_cancel(L, ev);
     if (poll_unwatch_event(L, ev) == POLL_ERROR) {
         // got error
         lua_pushnil(L);
@@ -110,7 +139,17 @@ int poll_event_revert_lua(lua_State *L, const char *tname)
     ev->filter    = 0;
     ev->reg_evt   = (event_t){0};
     ev->occ_evt   = (event_t){0};
+    ev->occ_data  = 0;
+    ev->timer     = (poll_timer_t){
+        .idx = -1,
+        .ev  = ev,
+    };
+    ev->idle      = (poll_timer_t){
+        .idx = -1,
+        .ev  = ev,
+    };
     ev->ref_udata = unref(L, ev->ref_udata);
+    poll_handler_release(L, ev);
     lua_settop(L, 1);
     luaL_getmetatable(L, POLL_EVENT_MT);
     lua_setmetatable(L, -2);
@@ -118,109 +157,246 @@ int poll_event_revert_lua(lua_State *L, const char *tname)
     return 1;
 }
 
-int poll_evset_getflag(lua_State *L, int ref_filter_evset, int ident)
+void poll_pending_add(poll_t *p, poll_event_t *ev)
 {
-    pushref(L, ref_filter_evset);
-    lua_rawgeti(L, -1, ident);
-    if (!lua_isnil(L, -1)) {
+    if (ev->pending) {
+        // already queued
+        return;
+    }
+
+    // NOTE: the events in the pending list are not reported by the kernel
+    ev->occ_evt = (event_t){
+        .events = EPOLLIN,
+        .data   = ev->reg_evt.data,
+    };
+    ev->occ_data = 0;
+
+    // append to the tail of pending list
+    ev->pending      = 1;
+    ev->pending_prev = p->pending_tail;
+    ev->pending_next = NULL;
+    if (p->pending_tail) {
+        p->pending_tail->pending_next = ev;
+    } else {
+        p->pending_head = ev;
+    }
+    p->pending_tail = ev;
+    p->npending++;
+}
+
+void poll_pending_del(poll_t *p, poll_event_t *ev)
+{
+    if (!ev->pending) {
+        return;
+    }
+
+    if (ev->pending_prev) {
+        ev->pending_prev->pending_next = ev->pending_next;
+    } else {
+        p->pending_head = ev->pending_next;
+    }
+    if (ev->pending_next) {
+        ev->pending_next->pending_prev = ev->pending_prev;
+    } else {
+        p->pending_tail = ev->pending_prev;
+    }
+    ev->pending      = 0;
+    ev->pending_prev = NULL;
+    ev->pending_next = NULL;
+    p->npending--;
+}
+
+poll_event_t *poll_pending_shift(poll_t *p)
+{
+    poll_event_t *ev = p->pending_head;
+
+    if (ev) {
+        poll_pending_del(p, ev);
+    }
+    return ev;
+}
+
+// cancel the timeout of ev:await()
+static inline void await_timeout_cancel(poll_event_t *ev)
+{
+    ev->timedout = 0;
+    if (ev->filter != EVFILT_TIMER) {
+        poll_timer_del(ev->p, ev);
+    }
+}
+
+// returns true if the event is kept in the fd-indexed event table
+static inline int evset_has_fdslot(poll_event_t *ev)
+{
+    return ev->filter != EVFILT_TIMER && ev->filter != EVFILT_SIGNAL;
+}
+
+static int fdset_grow(poll_t *p, int fd)
+{
+    if (fd < 0) {
+        errno = EBADF;
+        return POLL_ERROR;
+    } else if (fd < p->fdsize) {
+        return POLL_OK;
+    }
+
+    int size = (p->fdsize) ? p->fdsize : POLL_FDSET_MIN;
+    while (size <= fd) {
+        size *= 2;
+    }
+
+    poll_fdslot_t *fdset = realloc(p->fdset, sizeof(poll_fdslot_t) * size);
+    if (!fdset) {
+        return POLL_ERROR;
+    }
+    // clear new slots
+    memset(fdset + p->fdsize, 0, sizeof(poll_fdslot_t) * (size - p->fdsize));
+    p->fdset  = fdset;
+    p->fdsize = size;
+
+    return POLL_OK;
+}
+
+int poll_evset_reserve(poll_t *p, int size)
+{
+    // preallocate the event table for the fd less than size
+    return (size > 0) ? fdset_grow(p, size - 1) : POLL_OK;
+}
+
+int poll_evset_getflag(lua_State *L, poll_t *p, int filter, int ident)
+{
+    switch (filter) {
+    case EVFILT_SIGNAL:
+        return sigismember(&p->sigset, ident) == 1;
+
+    case EVFILT_TIMER:
+        // NOTE: timer identifier is an arbitrary integer value
+        pushref(L, p->ref_evset_timer);
+        lua_rawgeti(L, -1, ident);
+        if (!lua_isnil(L, -1)) {
+            lua_pop(L, 2);
+            return 1;
+        }
         lua_pop(L, 2);
-        return 1;
+        return 0;
+
+    default:
+        if (ident < 0 || ident >= p->fdsize) {
+            return 0;
+        }
+        return (p->fdset[ident].filters & EVFILT_BIT(filter)) != 0;
     }
-    lua_pop(L, 2);
-    return 0;
 }
 
 static void evset_setflag(lua_State *L, poll_event_t *ev)
 {
-    int ref_evset = LUA_NOREF;
-
     switch (ev->filter) {
-    case EVFILT_READ:
-        ref_evset = ev->p->ref_evset_read;
-        break;
-    case EVFILT_WRITE:
-        ref_evset = ev->p->ref_evset_write;
-        break;
     case EVFILT_SIGNAL:
-        ref_evset = ev->p->ref_evset_signal;
+        sigaddset(&ev->p->sigset, ev->ident);
+        ev->p->sigevs[ev->ident] = ev;
         break;
+
     case EVFILT_TIMER:
-        ref_evset = ev->p->ref_evset_timer;
+        pushref(L, ev->p->ref_evset_timer);
+        lua_pushboolean(L, 1);
+        lua_rawseti(L, -2, ev->ident);
+        lua_pop(L, 1);
         break;
-    case EVFILT_TRIGGER:
-        ref_evset = ev->p->ref_evset_trigger;
+
+    default:
+        ev->p->fdset[ev->ident].filters |= EVFILT_BIT(ev->filter);
         break;
     }
-
-    pushref(L, ref_evset);
-    lua_pushboolean(L, 1);
-    lua_rawseti(L, -2, ev->ident);
-    lua_pop(L, 1);
 }
 
 static void evset_unsetflag(lua_State *L, poll_event_t *ev)
 {
-    int ref_evset = LUA_NOREF;
-
     switch (ev->filter) {
-    case EVFILT_READ:
-        ref_evset = ev->p->ref_evset_read;
-        break;
-    case EVFILT_WRITE:
-        ref_evset = ev->p->ref_evset_write;
-        break;
     case EVFILT_SIGNAL:
-        ref_evset = ev->p->ref_evset_signal;
+        sigdelset(&ev->p->sigset, ev->ident);
+        ev->p->sigevs[ev->ident] = NULL;
         break;
+
     case EVFILT_TIMER:
-        ref_evset = ev->p->ref_evset_timer;
+        pushref(L, ev->p->ref_evset_timer);
+        lua_pushnil(L);
+        lua_rawseti(L, -2, ev->ident);
+        lua_pop(L, 1);
         break;
-    case EVFILT_TRIGGER:
-        ref_evset = ev->p->ref_evset_trigger;
+
+    default:
+        ev->p->fdset[ev->ident].filters &= ~EVFILT_BIT(ev->filter);
         break;
     }
-
-    pushref(L, ref_evset);
-    lua_pushnil(L);
-    lua_rawseti(L, -2, ev->ident);
-    lua_pop(L, 1);
 }
 
-poll_event_t *poll_evset_get(lua_State *L, poll_t *p, event_t *evt)
+poll_event_t *poll_evset_get(poll_t *p, event_t *evt)
 {
-    // get poll_event_t at the ident index
-    pushref(L, p->ref_evset);
-    lua_rawgeti(L, -1, evt->data.fd);
-    if (lua_isnil(L, -1)) {
-        lua_pop(L, 2);
+    poll_event_t *ev = NULL;
+
+    // get poll_event_t at the fd index
+    if (evt->data.fd < 0 || evt->data.fd >= p->fdsize) {
+        return NULL;
+    }
+    ev = p->fdset[evt->data.fd].ev;
+    // NOTE: the disarmed event is kept in the table but it is not watched.
+    // the event that is reported for the previous registration of the fd is
+    // stale (e.g. the fd was closed and reused by another event), so it is
+    // detected by the generation of the registration.
+    if (!ev || !ev->enabled || ev->reg_evt.data.u64 != evt->data.u64) {
         return NULL;
     }
-    // remove event set table
-    lua_replace(L, -2);
-    return lua_touserdata(L, -1);
+    return ev;
 }
 
-static int evset_add(lua_State *L, poll_event_t *ev, int poll_event_idx)
+int poll_evset_add(lua_State *L, poll_event_t *ev, int poll_event_idx)
 {
-    // check if event fd is already registered
-    pushref(L, ev->p->ref_evset);
-    lua_rawgeti(L, -1, ev->reg_evt.data.fd);
-    if (!lua_isnil(L, -1)) {
-        lua_pop(L, 2);
+    poll_t *p = ev->p;
+    int fd    = ev->reg_evt.data.fd;
+
+    if (ev->ref_self != LUA_NOREF) {
+        // event is already registered
         return POLL_EALREADY;
     }
-    lua_pop(L, 1);
+    // discard the error of the previous registration
+    ev->ctl_errno = 0;
+    if (evset_has_fdslot(ev)) {
+        // grow the event table to be able to hold the fd and ident
+        if (fdset_grow(p, fd) != POLL_OK ||
+            fdset_grow(p, ev->ident) != POLL_OK) {
+            return POLL_ERROR;
+        } else if (p->fdset[fd].ev && p->fdset[fd].ev != ev) {
+            poll_event_t *cur = p->fdset[fd].ev;
+            if (!cur->disarmed) {
+                // event fd is already registered by other event
+                errno = EEXIST;
+                return POLL_ERROR;
+            }
+            // take over the kernel registration of the disarmed event
+            cur->disarmed = 0;
+            ev->disarmed  = 1;
+        }
+        // set poll_event_t at the fd index
+        p->fdset[fd].ev = ev;
+        poll_evdata_setgen(&ev->reg_evt, ++p->evgen);
+    }
 
-    // set poll_event_t at the fd index
-    lua_pushvalue(L, poll_event_idx);
-    lua_rawseti(L, -2, ev->reg_evt.data.fd);
+    // keep the reference of the event while it is registered
+    ev->ref_self = getrefat(L, poll_event_idx);
     // increment registered event counter
-    ev->p->nreg++;
-    lua_pop(L, 1);
+    p->nreg++;
 
     // set flag to prevent double registration
     evset_setflag(L, ev);
 
+    // start the idle timeout while the event is registered
+    if (poll_timer_idle_add(p, ev) != POLL_OK) {
+        int err = errno;
+        poll_evset_del(L, ev);
+        errno = err;
+        return POLL_ERROR;
+    }
+
     return POLL_OK;
 }
 
@@ -230,36 +406,79 @@ int poll_watch_event(lua_State *L, poll_event_t *ev, int poll_event_idx)
         // return error if already registered
         errno = EEXIST;
         return POLL_EALREADY;
-    } else if (evset_add(L, ev, poll_event_idx) != POLL_OK) {
+    }
+
+    switch (poll_evset_add(L, ev, poll_event_idx)) {
+    case POLL_OK:
+        break;
+    case POLL_EALREADY:
         return luaL_error(L, "[BUG] %s:%d: invalid implementation", __FILE__,
                           __LINE__);
+    default:
+        return POLL_ERROR;
     }
 
     // register event
-    if (epoll_ctl(ev->p->fd, EPOLL_CTL_ADD, ev->reg_evt.data.fd,
-                  &ev->reg_evt) == -1) {
+    int rv = 0;
+    switch (ev->filter) {
+    case EVFILT_SIGNAL:
+        rv = poll_signal_watch(ev->p, ev);
+        break;
+    case EVFILT_TIMER:
+        rv = poll_timer_add(ev->p, ev);
+        break;
+    default:
+        if (ev->disarmed) {
+            if (ev->reg_evt.events & EPOLLEXCLUSIVE) {
+                // NOTE: EPOLLEXCLUSIVE cannot be used with EPOLL_CTL_MOD
+                poll_evctl(ev->p, EPOLL_CTL_DEL, ev->reg_evt.data.fd, NULL);
+            } else {
+                // re-enable the kernel registration of the disarmed event
+                rv = poll_evctl(ev->p, EPOLL_CTL_MOD, ev->reg_evt.data.fd,
+                                &ev->reg_evt);
+                if (rv == 0 || errno != ENOENT) {
+                    break;
+                }
+                // NOTE: the registration has been removed by the kernel
+                // (e.g. the fd was closed or the epoll instance was renewed)
+            }
+            ev->disarmed = 0;
+        }
+        rv = poll_evctl(ev->p, EPOLL_CTL_ADD, ev->reg_evt.data.fd,
+                        &ev->reg_evt);
+    }
+    if (rv == -1) {
+        int err = errno;
+        poll_detach_event(ev);
         poll_evset_del(L, ev);
+        errno = err;
         return POLL_ERROR;
     }
-    ev->enabled = 1;
+    ev->enabled  = 1;
+    ev->disarmed = 0;
 
     return POLL_OK;
 }
 
 void poll_evset_del(lua_State *L, poll_event_t *ev)
 {
-    // delete poll_event_t at the ident index
-    pushref(L, ev->p->ref_evset);
-    lua_rawgeti(L, -1, ev->reg_evt.data.fd);
-    if (!lua_isnil(L, -1)) {
-        lua_pop(L, 1);
-        lua_pushnil(L);
-        lua_rawseti(L, -2, ev->reg_evt.data.fd);
-        ev->p->nreg--;
-        // unset flag
-        evset_unsetflag(L, ev);
+    poll_t *p = ev->p;
+    int fd    = ev->reg_evt.data.fd;
+
+    if (ev->ref_self == LUA_NOREF) {
+        // event is not registered
+        return;
     }
-    lua_pop(L, 1);
+    poll_timer_idle_del(p, ev);
+    if (evset_has_fdslot(ev) && fd >= 0 && fd < p->fdsize &&
+               p->fdset[fd].ev == ev) {
+        // delete poll_event_t at the fd index
+        p->fdset[fd].ev = NULL;
+    }
+    ev->ref_self = unref(L, ev->ref_self);
+    p->nreg--;
+    // unset flag
+    evset_unsetflag(L, ev);
 }
 
 int poll_unwatch_event(lua_State *L, poll_event_t *ev)
@@ -268,11 +487,23 @@ int poll_unwatch_event(lua_State *L, poll_event_t *ev)
 
     if (!ev->enabled) {
         // not watched
+        poll_detach_event(ev);
         return POLL_EALREADY;
     }
 
+    // discard the occurred event that has not been consumed
+    poll_pending_del(ev->p, ev);
+    await_timeout_cancel(ev);
+
     // unregister event
-    if (epoll_ctl(ev->p->fd, EPOLL_CTL_DEL, ev->reg_evt.data.fd, NULL) == -1) {
+    if (ev->filter == EVFILT_SIGNAL) {
+        if (poll_signal_unwatch(ev->p, ev) == POLL_ERROR) {
+            return POLL_ERROR;
+        }
+    } else if (ev->filter == EVFILT_TIMER) {
+        poll_timer_del(ev->p, ev);
+    } else if (poll_evctl(ev->p, EPOLL_CTL_DEL, ev->reg_evt.data.fd, NULL) ==
+               -1) {
         switch (errno) {
         case EBADF:  // p->fd or data.fd is not a valid fd
         case ENOENT: // data.fd is not registered with this epoll instance
@@ -298,6 +529,404 @@ int poll_unwatch_event(lua_State *L, poll_event_t *ev)
     return POLL_OK;
 }
 
+static inline poll_event_t *getevent(lua_State *L, int idx, int i)
+{
+    poll_event_t *ev = NULL;
+
+    lua_rawgeti(L, idx, i);
+    ev = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    return ev;
+}
+
+// revert the registration of the first n events in the array at idx
+static void watch_events_revert(lua_State *L, int idx, int n)
+{
+    for (int i = 1; i <= n; i++) {
+        poll_event_t *ev = getevent(L, idx, i);
+        poll_detach_event(ev);
+        poll_evset_del(L, ev);
+    }
+}
+
+// register the prepared events in the array at idx from 1 to n at once. the
+// epoll_ctl requests are submitted in a batch. if any of the events cannot
+// be registered, all of the events are reverted and it returns the index of
+// the failed event with errno. otherwise it returns 0.
+int poll_watch_events(lua_State *L, int idx, poll_ctlreq_t *reqs, int n)
+{
+    poll_t *p  = NULL;
+    int failed = 0;
+    int err    = 0;
+
+    for (int i = 1; i <= n; i++) {
+        poll_ctlreq_t *req = reqs + i - 1;
+        poll_event_t *ev   = NULL;
+
+        lua_rawgeti(L, idx, i);
+        ev = lua_touserdata(L, -1);
+        p  = ev->p;
+        switch (poll_evset_add(L, ev, lua_gettop(L))) {
+        case POLL_OK:
+            break;
+        case POLL_EALREADY:
+            // the same event is listed twice
+            errno = EEXIST;
+            // fallthrough
+        default:
+            err = errno;
+            lua_pop(L, 1);
+            watch_events_revert(L, idx, i - 1);
+            errno = err;
+            return i;
+        }
+        lua_pop(L, 1);
+
+        *req = (poll_ctlreq_t){
+            .op  = EPOLL_CTL_ADD,
+            .fd  = ev->reg_evt.data.fd,
+            .evt = &ev->reg_evt,
+            .idx = i,
+        };
+        if (ev->disarmed) {
+            if (ev->reg_evt.events & EPOLLEXCLUSIVE) {
+                // NOTE: EPOLLEXCLUSIVE cannot be used with EPOLL_CTL_MOD
+                poll_evctl(p, EPOLL_CTL_DEL, req->fd, NULL);
+                ev->disarmed = 0;
+            } else {
+                // re-enable the kernel registration of the disarmed event
+                req->op = EPOLL_CTL_MOD;
+            }
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    poll_evctl_batch(p, reqs, n);
+    for (int i = 0; i < n; i++) {
+        poll_ctlreq_t *req = reqs + i;
+        if (req->op == EPOLL_CTL_MOD && req->res == -ENOENT) {
+            // NOTE: the registration has been removed by the kernel
+            req->op  = EPOLL_CTL_ADD;
+            req->res = 0;
+            if (poll_evctl(p, EPOLL_CTL_ADD, req->fd, req->evt) == -1) {
+                req->res = -errno;
+            }
+        }
+        if (req->res < 0 && !failed) {
+            failed = req->idx;
+            err    = -req->res;
+        }
+    }
+    if (failed) {
+        // unregister the events that have been registered with the kernel
+        int ndel = 0;
+        for (int i = 0; i < n; i++) {
+            if (reqs[i].res == 0) {
+                reqs[ndel++] = (poll_ctlreq_t){
+                    .op  = EPOLL_CTL_DEL,
+                    .fd  = reqs[i].fd,
+                    .idx = reqs[i].idx,
+                };
+            }
+        }
+        if (ndel) {
+            poll_evctl_batch(p, reqs, ndel);
+        }
+        watch_events_revert(L, idx, n);
+        errno = err;
+        return failed;
+    }
+
+    for (int i = 1; i <= n; i++) {
+        poll_event_t *ev = getevent(L, idx, i);
+        ev->enabled      = 1;
+        ev->disarmed     = 0;
+    }
+    return 0;
+}
+
+// unregister the events in the array at idx from 1 to n at once. the
+// epoll_ctl requests are submitted in a batch. it returns the index of the
+// first event that could not be unregistered with errno, otherwise 0.
+int poll_unwatch_events(lua_State *L, int idx, poll_ctlreq_t *reqs, int n)
+{
+    poll_t *p  = NULL;
+    int nreq   = 0;
+    int failed = 0;
+    int err    = 0;
+
+    for (int i = 1; i <= n; i++) {
+        poll_event_t *ev = getevent(L, idx, i);
+
+        if (!ev->enabled) {
+            // not watched
+            poll_detach_event(ev);
+        } else if (ev->filter == EVFILT_SIGNAL || ev->filter == EVFILT_TIMER) {
+            // event that is not registered with epoll directly
+            if (poll_unwatch_event(L, ev) == POLL_ERROR && !failed) {
+                failed = i;
+                err    = errno;
+            }
+        } else {
+            // discard the occurred event that has not been consumed
+            p = ev->p;
+            poll_pending_del(p, ev);
+            await_timeout_cancel(ev);
+            reqs[nreq++] = (poll_ctlreq_t){
+                .op  = EPOLL_CTL_DEL,
+                .fd  = ev->reg_evt.data.fd,
+                .idx = i,
+            };
+        }
+    }
+    if (nreq) {
+        poll_evctl_batch(p, reqs, nreq);
+    }
+
+    for (int i = 0; i < nreq; i++) {
+        poll_ctlreq_t *req = reqs + i;
+        poll_event_t *ev   = getevent(L, idx, req->idx);
+
+        switch (-req->res) {
+        case 0:
+        case EBADF:  // p->fd or data.fd is not a valid fd
+        case ENOENT: // data.fd is not registered with this epoll instance
+            break;
+
+        case EPERM:  // data.fd is not supported by epoll
+        case EINVAL: // p->fd is not an epoll fd
+            // NOTE: probably, these errors are caused by bad implementation
+            if (!failed || req->idx < failed) {
+                failed = req->idx;
+                err    = -req->res;
+            }
+            break;
+
+        default:
+            // the event is kept watched
+            if (!failed || req->idx < failed) {
+                failed = req->idx;
+                err    = -req->res;
+            }
+            continue;
+        }
+        ev->enabled = 0;
+        poll_evset_del(L, ev);
+    }
+
+    if (failed) {
+        errno = err;
+        return failed;
+    }
+    return 0;
+}
+
+int poll_disarm_event(lua_State *L, poll_event_t *ev)
+{
+    poll_t *p = ev->p;
+    int fd    = ev->reg_evt.data.fd;
+
+    if (!ev->enabled) {
+        // not watched
+        return POLL_EALREADY;
+    } else if (ev->filter == EVFILT_SIGNAL || ev->filter == EVFILT_TIMER) {
+        // event that is not registered with epoll directly
+        return poll_unwatch_event(L, ev);
+    }
+
+    // NOTE: the kernel has already disabled the oneshot event. keep the
+    // kernel registration and the fd slot so that the event can be re-armed
+    // by EPOLL_CTL_MOD.
+    poll_pending_del(p, ev);
+    await_timeout_cancel(ev);
+    ev->enabled  = 0;
+    ev->disarmed = 1;
+    poll_evset_del(L, ev);
+    p->fdset[fd].ev = ev;
+
+    return POLL_OK;
+}
+
+int poll_suspend_event(lua_State *L, poll_event_t *ev)
+{
+    int fd = ev->reg_evt.data.fd;
+
+    if (!ev->enabled) {
+        // not watched
+        return POLL_EALREADY;
+    } else if (ev->filter == EVFILT_SIGNAL || ev->filter == EVFILT_TIMER ||
+               (ev->reg_evt.events & (EV_ONESHOT | EPOLLEXCLUSIVE))) {
+        // NOTE: EPOLLEXCLUSIVE cannot be used with EPOLL_CTL_MOD
+        return poll_unwatch_event(L, ev);
+    }
+
+    // NOTE: mask the events of the registration as a oneshot event that is
+    // disabled after reporting EPOLLHUP or EPOLLERR once, and keep it so
+    // that the event can be re-armed by EPOLL_CTL_MOD like a oneshot event.
+    event_t evt = {
+        .events = EV_ONESHOT,
+        .data   = ev->reg_evt.data,
+    };
+    if (poll_evctl(ev->p, EPOLL_CTL_MOD, fd, &evt) == -1) {
+        return poll_unwatch_event(L, ev);
+    }
+    return poll_disarm_event(L, ev);
+}
+
+void poll_detach_event(poll_event_t *ev)
+{
+    poll_t *p = ev->p;
+    int fd    = ev->reg_evt.data.fd;
+
+    if (!ev->disarmed) {
+        return;
+    }
+    ev->disarmed = 0;
+    // release the kernel registration and the fd slot
+    if (fd >= 0 && fd < p->fdsize && p->fdset[fd].ev == ev) {
+        p->fdset[fd].ev = NULL;
+        poll_evctl(p, EPOLL_CTL_DEL, fd, NULL);
+    }
+}
+
+void poll_await_cancel(lua_State *L, poll_event_t *ev)
+{
+    // NOTE: the coroutine is released without resuming
+    if (ev->ref_co != LUA_NOREF) {
+        ev->ref_co = unref(L, ev->ref_co);
+        ev->p->nawait--;
+    }
+}
+
+void poll_handler_release(lua_State *L, poll_event_t *ev)
+{
+    if (ev->ref_handler != LUA_NOREF) {
+        ev->ref_handler = unref(L, ev->ref_handler);
+        ev->p->nhandler--;
+    }
+}
+
+int poll_event_on_lua(lua_State *L, const char *tname)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, tname);
+
+    if (lua_isnoneornil(L, 2)) {
+        // release the handler
+        poll_handler_release(L, ev);
+    } else {
+        luaL_checktype(L, 2, LUA_TFUNCTION);
+        int ref = getrefat(L, 2);
+        poll_handler_release(L, ev);
+        ev->ref_handler = ref;
+        ev->p->nhandler++;
+    }
+
+    lua_settop(L, 1);
+    return 1;
+}
+
+int poll_event_priority_lua(lua_State *L, const char *tname)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, tname);
+    int prio         = ev->prio;
+
+    if (!lua_isnoneornil(L, 2)) {
+        lua_Integer n = luaL_checkinteger(L, 2);
+        if (n < 0 || n >= POLL_NPRIO) {
+            return luaL_argerror(
+                L, 2,
+                lua_pushfstring(L, "priority must be in range 0 to %d",
+                                POLL_NPRIO - 1));
+        }
+        prio_release(ev);
+        ev->prio = (int)n;
+        prio_retain(ev);
+    }
+
+    // return the previous priority
+    lua_pushinteger(L, prio);
+    return 1;
+}
+
+int poll_event_set_idle_timeout_lua(lua_State *L, const char *tname)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, tname);
+    lua_Number sec   = luaL_optnumber(L, 2, 0);
+    uint64_t nsec    = 0;
+
+    // NOTE: zero or negative timeout disables the idle timeout
+    if (sec >= (lua_Number)(UINT32_MAX)) {
+        nsec = (uint64_t)UINT32_MAX * 1000000000;
+    } else if (sec > 0) {
+        nsec = (uint64_t)(sec * 1000000000);
+    }
+    poll_timer_idle_del(ev->p, ev);
+    ev->idle.interval = nsec;
+    if (ev->enabled && poll_timer_idle_add(ev->p, ev) != POLL_OK) {
+        ev->idle.interval = 0;
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+int poll_event_await_lua(lua_State *L, const char *tname)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, tname);
+    lua_Number sec   = luaL_optnumber(L, 2, -1);
+
+#if LUA_VERSION_NUM >= 503
+    if (!lua_isyieldable(L)) {
+#else
+    if (lua_pushthread(L)) {
+#endif
+        return luaL_error(L, "attempt to await outside a coroutine");
+    } else if (ev->ref_co != LUA_NOREF) {
+        pushref(L, ev->ref_co);
+        if (lua_tothread(L, -1) != L) {
+            // other coroutine is already awaiting the event
+            errno = EALREADY;
+            lua_pushboolean(L, 0);
+            lua_pushstring(L, strerror(errno));
+            lua_pushinteger(L, errno);
+            return 3;
+        }
+        lua_pop(L, 1);
+        // NOTE: this coroutine was resumed by others while awaiting the event,
+        // so the previous await is released before it awaits again
+        if (ev->filter != EVFILT_TIMER) {
+            poll_timer_del(ev->p, ev);
+        }
+        poll_await_cancel(L, ev);
+    }
+
+    // arm the event and the timeout
+    if ((!ev->enabled && poll_watch_event(L, ev, 1) == POLL_ERROR) ||
+        (sec >= 0 && ev->filter != EVFILT_TIMER &&
+         poll_timer_timeout(ev->p, ev,
+                            (sec >= (lua_Number)(UINT32_MAX)) ?
+                                (uint64_t)UINT32_MAX * 1000000000 :
+                                (uint64_t)(sec * 1000000000)) != POLL_OK)) {
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    // keep the coroutine until the event occurs. it will be resumed by
+    // ep:run() with the results of the await.
+    lua_pushthread(L);
+    ev->ref_co = getref(L);
+    ev->p->nawait++;
+    return lua_yield(L, 0);
+}
+
 int poll_event_watch_lua(lua_State *L, const char *tname)
 {
     poll_event_t *ev = luaL_checkudata(L, 1, tname);
@@ -326,6 +955,7 @@ int poll_event_unwatch_lua(lua_State *L, const char *tname)
 {
     poll_event_t *ev = luaL_checkudata(L, 1, tname);
 
+    poll_await_cancel(L, ev);
     switch (poll_unwatch_event(L, ev)) {
     case POLL_OK:
         // success
@@ -475,30 +1105,40 @@ int poll_event_udata_lua(lua_State *L, const char *tname)
     return 1;
 }
 
-static int push_event(lua_State *L, poll_event_t *ev, event_t evt)
+// remove the field of the table at the top of the stack, so that the reused
+// table does not keep the stale value.
+static inline void clearfield(lua_State *L, const char *k)
 {
-    int edge    = evt.events & EV_CLEAR;
-    int oneshot = evt.events & EV_ONESHOT;
-    int eof     = evt.events & EV_EOF;
+    lua_pushnil(L);
+    lua_setfield(L, -2, k);
+}
 
+static inline void setflag(lua_State *L, const char *k, int flag)
+{
+    if (flag) {
+        lua_pushboolean(L, 1);
+        lua_setfield(L, -2, k);
+    } else {
+        clearfield(L, k);
+    }
+}
+
+static int push_event(lua_State *L, poll_event_t *ev, event_t evt, int reuse)
+{
     // push event
-    lua_createtable(L, 0, 5);
+    if (reuse) {
+        // fill in the table that is passed by the caller
+        lua_settop(L, 3);
+    } else {
+        lua_createtable(L, 0, 5);
+    }
     pushref(L, ev->ref_udata);
     lua_setfield(L, -2, "udata");
     lua_pushinteger(L, ev->ident);
     lua_setfield(L, -2, "ident");
-    if (edge) {
-        lua_pushboolean(L, edge);
-        lua_setfield(L, -2, "edge");
-    }
-    if (oneshot) {
-        lua_pushboolean(L, oneshot);
-        lua_setfield(L, -2, "oneshot");
-    }
-    if (eof) {
-        lua_pushboolean(L, eof);
-        lua_setfield(L, -2, "eof");
-    }
+    setflag(L, "edge", evt.events & EV_CLEAR);
+    setflag(L, "oneshot", evt.events & EV_ONESHOT);
+    setflag(L, "eof", evt.events & EV_EOF);
 
     return 1;
 }
@@ -512,11 +1152,63 @@ int poll_event_getinfo_lua(lua_State *L, const char *tname)
     };
     poll_event_t *ev = luaL_checkudata(L, 1, tname);
     int selected     = luaL_checkoption(L, 2, NULL, opts);
+    int reuse        = !lua_isnoneornil(L, 3);
+
+    if (reuse) {
+        luaL_checktype(L, 3, LUA_TTABLE);
+    }
 
     switch (selected) {
     case 0:
-        return push_event(L, ev, ev->reg_evt);
+        push_event(L, ev, ev->reg_evt, reuse);
+        if (reuse) {
+            clearfield(L, "data");
+            clearfield(L, "pid");
+            clearfield(L, "status");
+            clearfield(L, "code");
+        }
+        return 1;
     default:
-        return push_event(L, ev, ev->occ_evt);
+        push_event(L, ev, ev->occ_evt, reuse);
+        switch (ev->filter) {
+        case EVFILT_SIGNAL:
+        case EVFILT_TIMER:
+        case EVFILT_TRIGGER:
+            // NOTE: data that has been read while draining the event
+            lua_pushinteger(L, (lua_Integer)ev->occ_data);
+            lua_setfield(L, -2, "data");
+            break;
+        default:
+            if (reuse) {
+                clearfield(L, "data");
+            }
+        }
+        if (ev->filter == EVFILT_SIGNAL) {
+            lua_pushinteger(L, ev->occ_pid);
+            lua_setfield(L, -2, "pid");
+            lua_pushinteger(L, ev->occ_status);
+            lua_setfield(L, -2, "status");
+            lua_pushinteger(L, ev->occ_code);
+            lua_setfield(L, -2, "code");
+        } else if (reuse) {
+            clearfield(L, "pid");
+            clearfield(L, "status");
+            clearfield(L, "code");
+        }
+        return 1;
     }
 }
+
+int poll_event_events_lua(lua_State *L, const char *tname)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, tname);
+    lua_pushinteger(L, ev->reg_evt.events);
+    return 1;
+}
+
+int poll_event_revents_lua(lua_State *L, const char *tname)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, tname);
+    lua_pushinteger(L, ev->occ_evt.events);
+    return 1;
+}
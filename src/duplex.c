@@ -0,0 +1,314 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_epoll.h"
+
+#define MODULE_MT POLL_DUPLEX_MT
+
+static int getinfo_lua(lua_State *L)
+{
+    return poll_event_getinfo_lua(L, MODULE_MT);
+}
+
+static int events_lua(lua_State *L)
+{
+    return poll_event_events_lua(L, MODULE_MT);
+}
+
+static int revents_lua(lua_State *L)
+{
+    return poll_event_revents_lua(L, MODULE_MT);
+}
+
+static int await_lua(lua_State *L)
+{
+    return poll_event_await_lua(L, MODULE_MT);
+}
+
+static int on_lua(lua_State *L)
+{
+    return poll_event_on_lua(L, MODULE_MT);
+}
+
+static int priority_lua(lua_State *L)
+{
+    return poll_event_priority_lua(L, MODULE_MT);
+}
+
+static int set_idle_timeout_lua(lua_State *L)
+{
+    return poll_event_set_idle_timeout_lua(L, MODULE_MT);
+}
+
+static int udata_lua(lua_State *L)
+{
+    return poll_event_udata_lua(L, MODULE_MT);
+}
+
+static int ident_lua(lua_State *L)
+{
+    return poll_event_ident_lua(L, MODULE_MT);
+}
+
+static int as_oneshot_lua(lua_State *L)
+{
+    return poll_event_as_oneshot_lua(L, MODULE_MT);
+}
+
+static int is_oneshot_lua(lua_State *L)
+{
+    return poll_event_is_oneshot_lua(L, MODULE_MT);
+}
+
+// change the trigger mode of the duplex event without EPOLLEXCLUSIVE
+static int as_trigger(lua_State *L, uint32_t events)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, MODULE_MT);
+
+    if (ev->enabled) {
+        // event is in use
+        errno = EINPROGRESS;
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    // NOTE: EPOLLEXCLUSIVE cannot be used with EPOLL_CTL_MOD that is issued
+    // by want_read and want_write
+    ev->reg_evt.events &= ~(EV_ONESHOT | EV_CLEAR | EPOLLEXCLUSIVE);
+    ev->reg_evt.events |= events;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int as_edge_lua(lua_State *L)
+{
+    return as_trigger(L, EV_CLEAR);
+}
+
+static int is_edge_lua(lua_State *L)
+{
+    return poll_event_is_edge_lua(L, MODULE_MT);
+}
+
+static int as_level_lua(lua_State *L)
+{
+    return as_trigger(L, 0);
+}
+
+static int is_level_lua(lua_State *L)
+{
+    return poll_event_is_level_lua(L, MODULE_MT);
+}
+
+static int is_eof_lua(lua_State *L)
+{
+    return poll_event_is_eof_lua(L, MODULE_MT);
+}
+
+static int is_enabled_lua(lua_State *L)
+{
+    return poll_event_is_enabled_lua(L, MODULE_MT);
+}
+
+static int unwatch_lua(lua_State *L)
+{
+    return poll_event_unwatch_lua(L, MODULE_MT);
+}
+
+static int watch_lua(lua_State *L)
+{
+    return poll_event_watch_lua(L, MODULE_MT);
+}
+
+static int revert_lua(lua_State *L)
+{
+    return poll_event_revert_lua(L, MODULE_MT);
+}
+
+static int renew_lua(lua_State *L)
+{
+    return poll_event_renew_lua(L, MODULE_MT);
+}
+
+static int is_readable_lua(lua_State *L)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, MODULE_MT);
+    lua_pushboolean(L, ev->occ_evt.events & EPOLLIN);
+    return 1;
+}
+
+static int is_writable_lua(lua_State *L)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, MODULE_MT);
+    lua_pushboolean(L, ev->occ_evt.events & EPOLLOUT);
+    return 1;
+}
+
+// change the interest of the event without unwatching it
+static int want_events(lua_State *L, uint32_t events)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, MODULE_MT);
+    uint32_t prev    = ev->reg_evt.events;
+
+    luaL_checktype(L, 2, LUA_TBOOLEAN);
+    if (lua_toboolean(L, 2)) {
+        ev->reg_evt.events |= events;
+    } else {
+        ev->reg_evt.events &= ~events;
+    }
+
+    if (ev->enabled && ev->reg_evt.events != prev &&
+        poll_evctl(ev->p, EPOLL_CTL_MOD, ev->reg_evt.data.fd, &ev->reg_evt) ==
+            -1) {
+        // got error
+        ev->reg_evt.events = prev;
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int want_write_lua(lua_State *L)
+{
+    return want_events(L, EPOLLOUT);
+}
+
+static int want_read_lua(lua_State *L)
+{
+    return want_events(L, EPOLLIN);
+}
+
+static int type_lua(lua_State *L)
+{
+    lua_pushliteral(L, "duplex");
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    return poll_event_tostring_lua(L, MODULE_MT);
+}
+
+static int gc_lua(lua_State *L)
+{
+    return poll_event_gc_lua(L);
+}
+
+int poll_duplex_new(lua_State *L)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, POLL_EVENT_MT);
+    int fd           = luaL_checkinteger(L, 2);
+
+    if (poll_evset_getflag(L, ev->p, EVFILT_DUPLEX, fd) ||
+        poll_evset_getflag(L, ev->p, EVFILT_READ, fd) ||
+        poll_evset_getflag(L, ev->p, EVFILT_WRITE, fd)) {
+        // already registered
+        errno = EEXIST;
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    ev->ident  = fd;
+    ev->filter = EVFILT_DUPLEX;
+    // NOTE: EPOLLEXCLUSIVE cannot be used with EPOLL_CTL_MOD
+    ev->reg_evt.events &= ~EPOLLEXCLUSIVE;
+    ev->reg_evt.events |= EPOLLIN | EPOLLOUT;
+    ev->reg_evt.data.fd = fd;
+    if (poll_watch_event(L, ev, 1) != POLL_OK) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+    // keep udata reference
+    if (!lua_isnoneornil(L, 3)) {
+        ev->ref_udata = getrefat(L, 3);
+    }
+
+    lua_settop(L, 1);
+    luaL_getmetatable(L, MODULE_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+void libopen_poll_duplex(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"type",             type_lua            },
+        {"renew",            renew_lua           },
+        {"revert",           revert_lua          },
+        {"watch",            watch_lua           },
+        {"rearm",            watch_lua           },
+        {"unwatch",          unwatch_lua         },
+        {"want_read",        want_read_lua       },
+        {"want_write",       want_write_lua      },
+        {"is_readable",      is_readable_lua     },
+        {"is_writable",      is_writable_lua     },
+        {"is_enabled",       is_enabled_lua      },
+        {"is_eof",           is_eof_lua          },
+        {"is_level",         is_level_lua        },
+        {"as_level",         as_level_lua        },
+        {"is_edge",          is_edge_lua         },
+        {"as_edge",          as_edge_lua         },
+        {"is_oneshot",       is_oneshot_lua      },
+        {"as_oneshot",       as_oneshot_lua      },
+        {"ident",            ident_lua           },
+        {"udata",            udata_lua           },
+        {"getinfo",          getinfo_lua         },
+        {"events",           events_lua          },
+        {"revents",          revents_lua         },
+        {"await",            await_lua           },
+        {"on",               on_lua              },
+        {"priority",         priority_lua        },
+        {"set_idle_timeout", set_idle_timeout_lua},
+        {NULL,               NULL                }
+    };
+
+    // create metatable
+    luaL_newmetatable(L, MODULE_MT);
+    // metamethods
+    for (struct luaL_Reg *ptr = mmethod; ptr->name; ptr++) {
+        lua_pushcfunction(L, ptr->func);
+        lua_setfield(L, -2, ptr->name);
+    }
+    // methods
+    lua_newtable(L);
+    for (struct luaL_Reg *ptr = method; ptr->name; ptr++) {
+        lua_pushcfunction(L, ptr->func);
+        lua_setfield(L, -2, ptr->name);
+    }
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
@@ -22,18 +22,17 @@
 
 #include "lua_epoll.h"
 #include <limits.h>
-#include <sys/signalfd.h>
+#include <stdlib.h>
 
 static int check_event_status(lua_State *L, poll_event_t *ev)
 {
     int rc = POLL_OK;
 
-    if (ev->reg_evt.events & EV_ONESHOT) {
-        // oneshot event should be disabled
-        if (poll_unwatch_event(L, ev) == POLL_ERROR) {
+    if ((ev->reg_evt.events & EV_ONESHOT) &&
+        !(ev->occ_evt.events & (EV_EOF | EV_ERROR))) {
+        // oneshot event should be disarmed until it is watched again
+        if (poll_disarm_event(L, ev) == POLL_ERROR) {
             return POLL_ERROR;
-        } else if (ev->occ_evt.events & (EV_EOF | EV_ERROR)) {
-            return EV_EOF;
         }
         rc = EV_ONESHOT;
     } else if (ev->occ_evt.events & (EV_EOF | EV_ERROR)) {
@@ -45,56 +44,102 @@ static int check_event_status(lua_State *L, poll_event_t *ev)
     }
 
     // drain event data
-    union {
-        struct signalfd_siginfo siginfo;
-        uint64_t nexpires;
-    } data;
-    int size = sizeof(uint64_t);
-    switch (ev->filter) {
-    case EVFILT_SIGNAL:
-        size = sizeof(struct signalfd_siginfo);
-        /* fall through */
-    case EVFILT_TIMER:
-    case EVFILT_TRIGGER:
-        if (read(ev->reg_evt.data.fd, (void *)&data, size) == -1) {
+    // NOTE: expired timers and received signals are drained from the shared
+    // timerfd and signalfd in wait()
+    if (ev->filter == EVFILT_TRIGGER) {
+        // keep the counter value of the eventfd
+        ev->p->stats.nread++;
+        if (poll_trigger_drain(ev->trigger, &ev->occ_data) == -1) {
             return POLL_ERROR;
         }
-        break;
     }
 
     return rc;
 }
 
-static int consume_lua(lua_State *L)
+// returns true if the event is reported by the internal descriptor
+static inline int is_internal_event(poll_t *p, event_t *evt)
 {
-    poll_t *p   = luaL_checkudata(L, 1, POLL_MT);
+    return evt->data.fd != -1 &&
+           (evt->data.fd == p->timerfd || evt->data.fd == p->signalfd);
+}
+
+// consume the next occurred event and push the results onto the stack.
+// it returns the number of pushed values, or 0 if no events remain.
+// if timedout is not NULL, the event that the await has timed out is set to
+// it and only the event is pushed. otherwise, such events are skipped.
+static int consume_event(lua_State *L, poll_t *p, poll_event_t **timedout)
+{
+    int base    = lua_gettop(L);
     event_t evt = {0};
 
 RECONSUME:
-    lua_settop(L, 1);
+    lua_settop(L, base);
 
-    if (p->nevt == 0) {
-        lua_pushnil(L);
+    // NOTE: the events that are not reported by the kernel directly (e.g.
+    // expired timers) are consumed first.
+    poll_event_t *ev = poll_pending_shift(p);
+    if (ev && ev->timedout) {
+        ev->timedout = 0;
+        if (ev->idled) {
+            // report the idle timeout at the next consumption
+            poll_pending_add(p, ev);
+        }
+        if (!timedout) {
+            goto RECONSUME;
+        }
+        *timedout = ev;
+        pushref(L, ev->ref_self);
         return 1;
-    }
+    } else if (ev && ev->idled && !ev->ctl_errno) {
+        // idle timeout has expired
+        ev->idled = 0;
+        pushref(L, ev->ref_self);
+        pushref(L, ev->ref_udata);
+        lua_pushnil(L);
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(ETIMEDOUT));
+        lua_pushinteger(L, ETIMEDOUT);
+        return 6;
+    } else if (!ev) {
+        if (p->nevt == 0) {
+            return 0;
+        }
 
-    evt = p->evlist[p->cur++];
-    if (p->cur >= p->nevt) {
-        // free event list if all events are consumed
-        p->nevt = 0;
-    }
+        evt = p->evlist[p->cur++];
+        if (p->cur >= p->nevt) {
+            // free event list if all events are consumed
+            p->nevt = 0;
+        }
 
-    // NOTE: if poll_evset_get() returns a poll_event_t instance, it is placed
-    // on the stack top.
-    poll_event_t *ev = poll_evset_get(L, p, &evt);
-    if (!ev) {
-        // event is already unwatched
-        goto RECONSUME;
+        ev = poll_evset_get(p, &evt);
+        if (!ev) {
+            // event is already unwatched, disarmed or it is an internal event
+            if (!is_internal_event(p, &evt)) {
+                p->stats.nskip++;
+            }
+            goto RECONSUME;
+        } else if (p->quota[ev->filter] &&
+                   p->nconsume[ev->filter] >= p->quota[ev->filter]) {
+            // NOTE: the consumed entries are no longer needed, so the
+            // deferred events are packed at the head of the event list
+            p->evlist[p->ndefer++] = evt;
+            goto RECONSUME;
+        }
+        p->nconsume[ev->filter]++;
+        ev->occ_evt  = evt;
+        ev->occ_data = 0;
+        // NOTE: the idle timeout is extended lazily by the last activity
+        ev->idle_at  = p->waited_at;
     }
-    ev->occ_evt = evt;
+    // NOTE: push the event before checking its status since the reference to
+    // the event will be released when it is unwatched.
+    pushref(L, ev->ref_self);
     pushref(L, ev->ref_udata);
 
     // check event status
+    int ctlerr    = ev->ctl_errno;
+    ev->ctl_errno = 0;
     switch (check_event_status(L, ev)) {
     case POLL_OK:
         return 2;
@@ -105,6 +150,12 @@ RECONSUME:
     case EV_EOF:
         lua_pushboolean(L, 1);
         lua_pushboolean(L, 1);
+        if (ctlerr) {
+            // the deferred registration has failed
+            lua_pushstring(L, strerror(ctlerr));
+            lua_pushinteger(L, ctlerr);
+            return 6;
+        }
         return 4;
 
     default:
@@ -116,27 +167,167 @@ RECONSUME:
     }
 }
 
+static int consume_lua(lua_State *L)
+{
+    poll_t *p = luaL_checkudata(L, 1, POLL_MT);
+    int nres  = 0;
+
+    lua_settop(L, 1);
+    nres = consume_event(L, p, NULL);
+    if (nres == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+    return nres;
+}
+
+static int dispatch_lua(lua_State *L)
+{
+    poll_t *p       = luaL_checkudata(L, 1, POLL_MT);
+    // default max: 0(consume all events)
+    lua_Integer max = luaL_optinteger(L, 3, 0);
+    lua_Integer n   = 0;
+
+    luaL_checktype(L, 2, LUA_TFUNCTION);
+    lua_settop(L, 2);
+    while (max <= 0 || n < max) {
+        // call function with the results of consume_event()
+        lua_pushvalue(L, 2);
+        int nres = consume_event(L, p, NULL);
+        if (nres == 0) {
+            break;
+        }
+        lua_call(L, nres, 0);
+        n++;
+    }
+
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+// check that the coroutine is still suspended in the ev:await() of the event.
+// the coroutine may have been resumed by others and yielded elsewhere, or be
+// awaiting another event.
+static int is_awaiting(lua_State *co, poll_event_t *ev)
+{
+    lua_Debug ar;
+    int ok = 0;
+
+    if (lua_status(co) != LUA_YIELD) {
+        return 0;
+    } else if (!lua_getstack(co, 0, &ar) || !lua_checkstack(co, 4)) {
+        // NOTE: the frame of the suspended coroutine cannot be inspected
+        return 1;
+    }
+
+    // the first argument of the yielding function must be the event, and the
+    // function must be the await method of the event
+    lua_getinfo(co, "f", &ar);
+    if (lua_getlocal(co, &ar, 1)) {
+        if (lua_touserdata(co, -1) == ev &&
+            luaL_getmetafield(co, -1, "__index")) {
+            lua_getfield(co, -1, "await");
+            ok = lua_rawequal(co, -1, -4);
+            lua_pop(co, 2);
+        }
+        lua_pop(co, 1);
+    }
+    lua_pop(co, 1);
+    return ok;
+}
+
+// resume the coroutine awaiting the event with the narg values on the top of
+// the stack
+static void resume_awaiting(lua_State *L, poll_event_t *ev, int narg)
+{
+    lua_State *co = NULL;
+    int nres      = 0;
+
+    if (ev->ref_co == LUA_NOREF) {
+        lua_pop(L, narg);
+        return;
+    }
+
+    // release the coroutine and the timeout of the await
+    if (ev->filter != EVFILT_TIMER) {
+        poll_timer_del(ev->p, ev);
+    }
+    pushref(L, ev->ref_co);
+    co         = lua_tothread(L, -1);
+    ev->ref_co = unref(L, ev->ref_co);
+    ev->p->nawait--;
+    // NOTE: keep the coroutine on the stack while it is running
+    lua_insert(L, -(narg + 1));
+    if (!is_awaiting(co, ev)) {
+        // coroutine has already been resumed by others
+        lua_pop(L, narg + 1);
+        return;
+    }
+
+    lua_xmove(L, co, narg);
+    switch (poll_resume(co, L, narg, &nres)) {
+    case 0:
+    case LUA_YIELD:
+        lua_pop(co, nres);
+        lua_pop(L, 1);
+        return;
+
+    default:
+        // propagate the error of the coroutine
+        lua_xmove(co, L, 1);
+        lua_error(L);
+    }
+}
+
 static int cleanup_unconsumed_events(lua_State *L, poll_t *p)
 {
+    poll_event_t *pev = NULL;
+    int npending      = p->npending;
+
+    while (npending-- > 0 && (pev = poll_pending_shift(p))) {
+        if (pev->timedout) {
+            // keep the timeout of ev:await() until it is handled by ep:run()
+            pev->idled = 0;
+            poll_pending_add(p, pev);
+            continue;
+        } else if (pev->idled) {
+            // discard the expiration of the idle timeout
+            pev->idled = 0;
+            continue;
+        }
+        switch (check_event_status(L, pev)) {
+        case POLL_OK:
+        case EV_ONESHOT:
+        case EV_EOF:
+            continue;
+
+        default:
+            return POLL_ERROR;
+        }
+    }
+
     while (p->cur < p->nevt) {
         event_t evt      = p->evlist[p->cur++];
-        poll_event_t *ev = poll_evset_get(L, p, &evt);
+        poll_event_t *ev = poll_evset_get(p, &evt);
 
         if (!ev) {
-            // event is already unwatched
+            // event is already unwatched or disarmed
+            if (!is_internal_event(p, &evt)) {
+                p->stats.nskip++;
+            }
             continue;
         }
-        ev->occ_evt = evt;
+        ev->occ_evt  = evt;
+        ev->occ_data = 0;
+        ev->idle_at  = p->waited_at;
 
         switch (check_event_status(L, ev)) {
         case POLL_OK:
         case EV_ONESHOT:
         case EV_EOF:
-            lua_pop(L, 1);
             continue;
 
         default:
-            lua_pop(L, 1);
             return POLL_ERROR;
         }
     }
@@ -146,14 +337,192 @@ static int cleanup_unconsumed_events(lua_State *L, poll_t *p)
     return POLL_OK;
 }
 
-static int wait_lua(lua_State *L)
+// wait for events until the timeout in seconds expires. negative timeout
+// means that it waits forever. if sigmask is not NULL, the signal mask is
+// replaced with it atomically while waiting.
+static int poll_wait(poll_t *p, event_t *evlist, int maxevents,
+                     lua_Number sec, const sigset_t *sigmask)
 {
-    poll_t *p      = luaL_checkudata(L, 1, POLL_MT);
-    // default timeout: -1(never timeout)
-    lua_Number sec = luaL_optnumber(L, 2, -1);
-    int msec       = (sec < 0)                             ? -1 :
-                     (sec >= (lua_Number)(INT_MAX / 1000)) ? INT_MAX :
-                                                             (int)(sec * 1000);
+#if HAVE_EPOLL_PWAIT2
+    static int pwait2_unsupported = 0;
+
+    if (!pwait2_unsupported) {
+        struct timespec ts       = {0};
+        struct timespec *timeout = NULL;
+        if (sec >= (lua_Number)INT_MAX) {
+            ts.tv_sec = INT_MAX;
+            timeout   = &ts;
+        } else if (sec >= 0) {
+            ts.tv_sec  = (time_t)sec;
+            ts.tv_nsec = (long)((sec - (lua_Number)ts.tv_sec) * 1000000000);
+            timeout    = &ts;
+        }
+
+        int nevt = epoll_pwait2(p->fd, evlist, maxevents, timeout,
+                                sigmask);
+        if (nevt != -1 || errno != ENOSYS) {
+            return nevt;
+        }
+        // NOTE: fallback to epoll_wait if the kernel does not support it
+        pwait2_unsupported = 1;
+    }
+#endif
+
+    int msec = (sec < 0)                             ? -1 :
+               (sec >= (lua_Number)(INT_MAX / 1000)) ? INT_MAX :
+                                                       (int)(sec * 1000);
+    if (sigmask) {
+#if HAVE_EPOLL_PWAIT
+        return epoll_pwait(p->fd, evlist, maxevents, msec, sigmask);
+#else
+        errno = ENOTSUP;
+        return -1;
+#endif
+    }
+    return epoll_wait(p->fd, evlist, maxevents, msec);
+}
+
+static int evlist_resize(poll_t *p, int size)
+{
+    event_t *evlist = realloc(p->evlist, sizeof(event_t) * size);
+
+    if (!evlist) {
+        return POLL_ERROR;
+    }
+    p->evlist  = evlist;
+    p->evsize  = size;
+    p->nshrink = 0;
+    return POLL_OK;
+}
+
+// resize the event list by the number of events of the last wait.
+// NOTE: the list is grown when it is filled up, and shrunk by half only when
+// less than a quarter of the list is used by POLL_EVLIST_SHRINK_WAITS
+// consecutive waits to avoid resizing it repeatedly.
+static void evlist_adjust(poll_t *p, int maxevents, int nevt)
+{
+    if (nevt == maxevents && maxevents == p->evsize &&
+        p->evsize < p->maxevents) {
+        int size = (p->evsize > p->maxevents / 2) ? p->maxevents :
+                                                    p->evsize * 2;
+        // NOTE: keep the current list if failed to grow
+        evlist_resize(p, size);
+    } else if (nevt >= p->evsize / 4 || p->evsize <= p->evmin) {
+        p->nshrink = 0;
+    } else if (++p->nshrink >= POLL_EVLIST_SHRINK_WAITS) {
+        int size = (p->evsize / 2 < p->evmin) ? p->evmin : p->evsize / 2;
+        evlist_resize(p, size);
+    }
+}
+
+static inline void stats_update(poll_stats_t *stats, int nevt)
+{
+    int i = 0;
+
+    stats->nevent += nevt;
+    // bucket of the histogram is floor(log2(nevt)) + 1
+    while (nevt > 0 && i < POLL_STATS_NHIST - 1) {
+        nevt >>= 1;
+        i++;
+    }
+    stats->hist[i]++;
+}
+
+// carry the deferred events over to the head of the event list. the level
+// triggered events are dropped since the kernel reports them again.
+static int carry_deferred_events(poll_t *p)
+{
+    int n = 0;
+
+    for (int i = 0; i < p->ndefer; i++) {
+        event_t evt      = p->evlist[i];
+        poll_event_t *ev = poll_evset_get(p, &evt);
+        if (ev && (ev->reg_evt.events & (EV_CLEAR | EV_ONESHOT))) {
+            p->evlist[n++] = evt;
+        }
+    }
+    p->ndefer = 0;
+    return n;
+}
+
+static inline void evlist_reverse(event_t *evlist, int from, int to)
+{
+    while (from < to) {
+        event_t evt    = evlist[from];
+        evlist[from++] = evlist[--to];
+        evlist[to]     = evt;
+    }
+}
+
+// rotate the event list to the left by n entries
+static inline void evlist_rotate(event_t *evlist, int nevt, int n)
+{
+    if (n > 0) {
+        evlist_reverse(evlist, 0, n);
+        evlist_reverse(evlist, n, nevt);
+        evlist_reverse(evlist, 0, nevt);
+    }
+}
+
+static inline int evlist_prio(poll_t *p, event_t *evt)
+{
+    poll_event_t *ev = poll_evset_get(p, evt);
+    return (ev) ? ev->prio : 0;
+}
+
+// partition the event list into the priority buckets in descending order.
+// NOTE: it scans the list once per non-zero priority instead of sorting it.
+static void evlist_partition(poll_t *p, event_t *evlist, int nevt)
+{
+    int head = 0;
+
+    for (int prio = POLL_NPRIO - 1; prio > 0 && head < nevt; prio--) {
+        for (int i = head; i < nevt; i++) {
+            if (evlist_prio(p, evlist + i) == prio) {
+                event_t evt    = evlist[i];
+                evlist[i]      = evlist[head];
+                evlist[head++] = evt;
+            }
+        }
+    }
+}
+
+// get the signal mask that unblocks the signals in the table at idx
+static int check_sigmask(lua_State *L, int idx, sigset_t *mask)
+{
+    luaL_checktype(L, idx, LUA_TTABLE);
+    if (sigprocmask(SIG_BLOCK, NULL, mask) == -1) {
+        return POLL_ERROR;
+    }
+
+    for (int i = 1;; i++) {
+        lua_rawgeti(L, idx, i);
+        if (lua_isnil(L, -1)) {
+            lua_pop(L, 1);
+            return POLL_OK;
+        } else if (!lua_isnumber(L, -1)) {
+            return luaL_argerror(L, idx, "signal numbers expected");
+        }
+        int signo = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        if (signo <= 0 || signo >= NSIG || sigdelset(mask, signo) == -1) {
+            errno = EINVAL;
+            return POLL_ERROR;
+        }
+    }
+}
+
+static int wait_events(lua_State *L, poll_t *p, lua_Number sec, int sigidx)
+{
+    sigset_t mask;
+
+    if (!lua_isnoneornil(L, sigidx) &&
+        check_sigmask(L, sigidx, &mask) == POLL_ERROR) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
 
     // cleanup current events
     if (cleanup_unconsumed_events(L, p) == POLL_ERROR) {
@@ -163,33 +532,98 @@ static int wait_lua(lua_State *L)
         return 3;
     }
 
+    // apply the deferred registration changes
+    if (poll_changelist_flush(p) > 0) {
+        // do not block since the errors are delivered as the events
+        sec = 0;
+    }
+
+    // the events deferred by the quotas are consumed first
+    int ncarry = carry_deferred_events(p);
+    if (ncarry > 0) {
+        sec = 0;
+    }
+    memset(p->nconsume, 0, sizeof(p->nconsume));
+
     if (p->nreg == 0) {
         // do not wait the event occurrs if no registered events exists
         lua_pushinteger(L, 0);
         return 1;
     }
 
-    // grow event list
-    if (p->evsize < p->nreg) {
-        p->evlist     = lua_newuserdata(L, sizeof(event_t) * p->nreg);
-        p->ref_evlist = unref(L, p->ref_evlist);
-        p->ref_evlist = getref(L);
-        p->evsize     = p->nreg;
+    int maxevents = p->evsize - ncarry;
+    if (p->nreg < maxevents) {
+        maxevents = p->nreg;
+    }
+    if (p->budget && p->budget - ncarry < maxevents) {
+        maxevents = p->budget - ncarry;
+    }
+    if (maxevents <= 0) {
+        // the event list is filled with the deferred events
+        p->nevt = ncarry;
+        lua_pushinteger(L, ncarry + p->npending);
+        return 1;
     }
 
-    int nevt = 0;
-    if (msec < 0) {
-        // wait event forever
-        nevt = epoll_wait(p->fd, p->evlist, p->nreg, -1);
-    } else {
-        // wait event until timeout occurs
-        nevt = epoll_wait(p->fd, p->evlist, p->nreg, msec);
+    event_t *evlist  = p->evlist + ncarry;
+    sigset_t *sigmask = lua_isnoneornil(L, sigidx) ? NULL : &mask;
+    lua_Number tmo    = sec;
+    uint64_t start    = poll_gettime();
+    int nevt          = poll_wait(p, evlist, maxevents, sec, sigmask);
+    while (nevt == -1 && errno == EINTR && poll_uring_interrupted()) {
+        // NOTE: the interruption caused by releasing the io_uring instance is
+        // not reported to the caller. wait again for the remaining time.
+        if (tmo > 0) {
+            lua_Number elapsed = (lua_Number)(poll_gettime() - start) / 1e9;
+            sec                = (elapsed < tmo) ? tmo - elapsed : 0;
+        }
+        nevt = poll_wait(p, evlist, maxevents, sec, sigmask);
     }
+    p->waited_at = poll_gettime();
+    p->stats.nwait++;
+    p->stats.wait_ns += p->waited_at - start;
 
     // return number of event
     if (nevt != -1) {
-        p->nevt = nevt;
-        lua_pushinteger(L, nevt);
+        int n = nevt;
+
+        if (p->rotate && nevt > 1) {
+            // NOTE: the kernel reports the ready events in the order they
+            // became ready, so rotate them not to favor the head of the list
+            evlist_rotate(evlist, nevt, (int)(p->evrot++ % (uint32_t)nevt));
+        }
+        p->nevt = ncarry + nevt;
+        stats_update(&p->stats, nevt);
+        for (int i = 0; i < nevt; i++) {
+            int fd = evlist[i].data.fd;
+            int rc = POLL_OK;
+            if (fd == p->timerfd && fd != -1) {
+                // move expired timers to the pending list
+                rc = poll_timer_expire(p);
+            } else if (fd == p->signalfd && fd != -1) {
+                // move signaled events to the pending list
+                rc = poll_signal_read(p);
+            } else {
+                continue;
+            }
+            // NOTE: the internal event itself is skipped in consume
+            if (rc == POLL_ERROR) {
+                lua_pushnil(L);
+                lua_pushstring(L, strerror(errno));
+                lua_pushinteger(L, errno);
+                return 3;
+            }
+            n--;
+        }
+        if (p->nprio > 0 && p->nevt > 1) {
+            // deliver the events of the higher priority first. the events
+            // carried over from the previous wait are partitioned together
+            // with the new ones.
+            evlist_partition(p, p->evlist, p->nevt);
+        }
+        // NOTE: the event list may be reallocated
+        evlist_adjust(p, ncarry + maxevents, ncarry + nevt);
+        lua_pushinteger(L, ncarry + n + p->npending);
         return 1;
     }
 
@@ -198,8 +632,10 @@ static int wait_lua(lua_State *L)
     // ignore error
     case ENOENT:
     case EINTR:
+        p->stats.nintr++;
         errno = 0;
-        lua_pushinteger(L, 0);
+        p->nevt = ncarry;
+        lua_pushinteger(L, ncarry);
         return 1;
 
     // return error
@@ -211,22 +647,564 @@ static int wait_lua(lua_State *L)
     }
 }
 
-static int new_event_lua(lua_State *L)
+static int wait_lua(lua_State *L)
+{
+    poll_t *p      = luaL_checkudata(L, 1, POLL_MT);
+    // default timeout: -1(never timeout)
+    lua_Number sec = luaL_optnumber(L, 2, -1);
+
+    return wait_events(L, p, sec, 3);
+}
+
+static int wait_until_lua(lua_State *L)
+{
+    poll_t *p           = luaL_checkudata(L, 1, POLL_MT);
+    lua_Number deadline = luaL_checknumber(L, 2);
+    lua_Number sec      = deadline - (lua_Number)poll_gettime() / 1000000000;
+
+    // NOTE: the deadline has already passed, poll events without blocking
+    return wait_events(L, p, (sec < 0) ? 0 : sec, 3);
+}
+
+// dispatch the next occurred event to the coroutine awaiting it or its
+// handler. it returns 0 if no events remain.
+static int dispatch_event(lua_State *L, poll_t *p)
+{
+    int base          = lua_gettop(L);
+    poll_event_t *tev = NULL;
+    poll_event_t *ev  = NULL;
+    int nres          = consume_event(L, p, &tev);
+
+    if (nres == 0) {
+        return 0;
+    }
+
+    ev = lua_touserdata(L, base + 1);
+    if (tev) {
+        // await has timed out
+        errno = ETIMEDOUT;
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        lua_pushboolean(L, 1);
+        resume_awaiting(L, ev, 4);
+    } else if (ev->ref_co != LUA_NOREF) {
+        if (nres == 6) {
+            // got error
+            lua_pushboolean(L, 0);
+            lua_pushvalue(L, base + 5);
+            lua_pushvalue(L, base + 6);
+            resume_awaiting(L, ev, 3);
+        } else {
+            lua_pushboolean(L, 1);
+            resume_awaiting(L, ev, 1);
+        }
+    } else if (ev->ref_handler != LUA_NOREF) {
+        // call handler with the results of consume_event()
+        pushref(L, ev->ref_handler);
+        lua_insert(L, base + 1);
+        lua_call(L, nres, 0);
+    } else if (ev->enabled) {
+        // NOTE: the event that has no coroutine and handler is disarmed
+        // until it is awaited or watched again
+        poll_suspend_event(L, ev);
+    }
+    lua_settop(L, base);
+
+    return 1;
+}
+
+// dispatch the occurred events until no events remain, the loop is stopped
+// or the budget is exhausted. it returns the number of dispatched events.
+static int dispatch_events(lua_State *L, poll_t *p, uint64_t budget)
+{
+    uint64_t start = (budget) ? poll_gettime() : 0;
+    int n          = 0;
+
+    while (!p->stopped && dispatch_event(L, p)) {
+        n++;
+        if (budget && poll_gettime() - start >= budget) {
+            // NOTE: the remaining events are dispatched in the next iteration
+            break;
+        }
+    }
+    return n;
+}
+
+// returns true if the occurred events have not been dispatched yet
+static inline int has_unconsumed_events(poll_t *p)
+{
+    return p->npending > 0 || p->cur < p->nevt;
+}
+
+// convert the optional seconds argument to nanoseconds, or 0 if not specified
+static uint64_t checkopt_nsec(lua_State *L, int idx)
+{
+    lua_Number sec = luaL_optnumber(L, idx, 0);
+
+    if (sec <= 0) {
+        return 0;
+    } else if (sec >= (lua_Number)(UINT32_MAX)) {
+        return (uint64_t)UINT32_MAX * 1000000000;
+    }
+    return (uint64_t)(sec * 1000000000);
+}
+
+static int run_lua(lua_State *L)
+{
+    poll_t *p          = luaL_checkudata(L, 1, POLL_MT);
+    // default timeout: -1(never timeout)
+    lua_Number sec     = luaL_optnumber(L, 2, -1);
+    uint64_t budget    = checkopt_nsec(L, 3);
+    lua_Number elapsed = 0;
+    uint64_t start     = poll_gettime();
+
+    lua_settop(L, 3);
+    p->stopped = 0;
+    while (!p->stopped && (p->nawait > 0 || p->nhandler > 0)) {
+        if (!has_unconsumed_events(p)) {
+            if (p->nreg == 0) {
+                // no events can be dispatched
+                break;
+            } else if (sec >= 0) {
+                elapsed = (lua_Number)(poll_gettime() - start) / 1000000000;
+                if (elapsed >= sec) {
+                    // timed out
+                    break;
+                }
+            }
+
+            if (wait_events(L, p, (sec < 0) ? -1 : sec - elapsed, 4) != 1) {
+                // got error
+                lua_pushboolean(L, 0);
+                lua_replace(L, -4);
+                return 3;
+            }
+            lua_settop(L, 3);
+        }
+        dispatch_events(L, p, budget);
+    }
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int run_once_lua(lua_State *L)
+{
+    poll_t *p       = luaL_checkudata(L, 1, POLL_MT);
+    // default timeout: -1(never timeout)
+    lua_Number sec  = luaL_optnumber(L, 2, -1);
+    uint64_t budget = checkopt_nsec(L, 3);
+
+    lua_settop(L, 3);
+    p->stopped = 0;
+    // NOTE: the remaining events of the previous iteration are dispatched
+    // without waiting
+    if (!has_unconsumed_events(p)) {
+        if (wait_events(L, p, sec, 4) != 1) {
+            // got error
+            return 3;
+        }
+        lua_settop(L, 3);
+    }
+
+    lua_pushinteger(L, dispatch_events(L, p, budget));
+    return 1;
+}
+
+static int stop_lua(lua_State *L)
+{
+    poll_t *p = luaL_checkudata(L, 1, POLL_MT);
+
+    // stop the loop after the current event is dispatched
+    p->stopped = 1;
+    return 0;
+}
+
+// create a new event of the poll instance at the index 1
+static poll_event_t *new_event(lua_State *L, poll_t *p)
 {
-    poll_t *p        = luaL_checkudata(L, 1, POLL_MT);
     poll_event_t *ev = lua_newuserdata(L, sizeof(poll_event_t));
 
     *ev = (poll_event_t){
-        .p         = p,
-        .ref_poll  = getrefat(L, 1),
-        .ref_udata = LUA_NOREF,
-        .reg_evt   = (event_t){0},
-        .occ_evt   = (event_t){0},
+        .p           = p,
+        .ref_poll    = getrefat(L, 1),
+        .ref_self    = LUA_NOREF,
+        .ref_udata   = LUA_NOREF,
+        .ref_co      = LUA_NOREF,
+        .ref_handler = LUA_NOREF,
+        .reg_evt     = (event_t){0},
+        .occ_evt     = (event_t){0},
+        .timer       = (poll_timer_t){
+            .idx = -1,
+            .ev  = ev,
+        },
+        .idle        = (poll_timer_t){
+            .idx = -1,
+            .ev  = ev,
+        },
     };
     // set metatable
     luaL_getmetatable(L, POLL_EVENT_MT);
     lua_setmetatable(L, -2);
 
+    return ev;
+}
+
+static int new_event_lua(lua_State *L)
+{
+    poll_t *p = luaL_checkudata(L, 1, POLL_MT);
+
+    new_event(L, p);
+    return 1;
+}
+
+// returns the event at the index if it is the event of the metatable tname
+static poll_event_t *toevent(lua_State *L, int idx, const char *tname)
+{
+    poll_event_t *ev = lua_touserdata(L, idx);
+
+    if (ev && lua_getmetatable(L, idx)) {
+        luaL_getmetatable(L, tname);
+        if (!lua_rawequal(L, -1, -2)) {
+            ev = NULL;
+        }
+        lua_pop(L, 2);
+        return ev;
+    }
+    return NULL;
+}
+
+// returns the event at the index if it is any type of the events
+static poll_event_t *toanyevent(lua_State *L, int idx)
+{
+    static const char *const tnames[] = {
+        POLL_EVENT_MT,  POLL_READ_MT,    POLL_WRITE_MT,  POLL_SIGNAL_MT,
+        POLL_TIMER_MT,  POLL_TRIGGER_MT, POLL_DUPLEX_MT, NULL,
+    };
+    poll_event_t *ev = NULL;
+
+    for (int i = 0; tnames[i]; i++) {
+        if ((ev = toevent(L, idx, tnames[i]))) {
+            return ev;
+        }
+    }
+    return NULL;
+}
+
+static int watch_many_lua(lua_State *L)
+{
+    static const char *const filters[] = {
+        "read",
+        "write",
+        NULL,
+    };
+    static const char *const triggers[] = {
+        "level",
+        "edge",
+        "oneshot",
+        NULL,
+    };
+    static const char *const tnames[] = {
+        POLL_READ_MT,
+        POLL_WRITE_MT,
+    };
+    poll_t *p           = luaL_checkudata(L, 1, POLL_MT);
+    int filter          = luaL_checkoption(L, 3, NULL, filters);
+    int trigger         = luaL_checkoption(L, 4, "level", triggers);
+    int n               = 0;
+    poll_ctlreq_t *reqs = NULL;
+    int nprep           = 0;
+    int failed          = 0;
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    n = (int)lua_objlen(L, 2);
+    lua_settop(L, 4);
+    // buffer of the epoll_ctl requests that is released by the gc
+    reqs = lua_newuserdata(L, sizeof(poll_ctlreq_t) * (n ? n : 1));
+    lua_createtable(L, n, 0);
+
+    // create or recycle the events
+    for (int i = 1; i <= n; i++) {
+        poll_event_t *ev = NULL;
+        int rv           = POLL_OK;
+
+        lua_rawgeti(L, 2, i);
+        if ((ev = toevent(L, -1, tnames[filter]))) {
+            // recycle the unwatched event
+            if (ev->p != p || ev->enabled) {
+                lua_pushfstring(L, "#%d is not an unwatched event of this "
+                                   "instance",
+                                i);
+                return luaL_argerror(L, 2, lua_tostring(L, -1));
+            }
+        } else if (lua_type(L, -1) == LUA_TNUMBER) {
+            int fd = (int)lua_tointeger(L, -1);
+            lua_pop(L, 1);
+            ev = new_event(L, p);
+            switch (trigger) {
+            case 1:
+                ev->reg_evt.events |= (EV_CLEAR | EPOLLEXCLUSIVE);
+                break;
+            case 2:
+                ev->reg_evt.events |= EV_ONESHOT;
+                break;
+            }
+            rv = (filter == 0) ? poll_read_prepare(L, ev, fd) :
+                                 poll_write_prepare(L, ev, fd);
+        } else {
+            lua_pushfstring(L, "#%d must be fd or %s", i, tnames[filter]);
+            return luaL_argerror(L, 2, lua_tostring(L, -1));
+        }
+        lua_rawseti(L, 6, i);
+
+        if (rv != POLL_OK) {
+            failed = i;
+            break;
+        }
+        nprep = i;
+    }
+    // register the events
+    if (!failed) {
+        failed = poll_watch_events(L, 6, reqs, n);
+    }
+
+    for (int i = 1; i <= n; i++) {
+        lua_rawgeti(L, 6, i);
+        if (toevent(L, -1, POLL_EVENT_MT)) {
+            poll_event_t *ev = lua_touserdata(L, -1);
+            if (failed) {
+                // close the fd that is duplicated by the created event
+                if (i <= nprep && ev->reg_evt.data.fd != ev->ident) {
+                    close(ev->reg_evt.data.fd);
+                    // NOTE: the fd number may be reused by another file, so
+                    // it must not be closed again when the event is released
+                    ev->reg_evt.data.fd = ev->ident;
+                }
+            } else {
+                luaL_getmetatable(L, tnames[filter]);
+                lua_setmetatable(L, -2);
+            }
+        }
+        lua_pop(L, 1);
+    }
+
+    if (failed) {
+        int err = errno;
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(err));
+        lua_pushinteger(L, err);
+        lua_pushinteger(L, failed);
+        return 4;
+    }
+    return 1;
+}
+
+static int unwatch_many_lua(lua_State *L)
+{
+    poll_t *p           = luaL_checkudata(L, 1, POLL_MT);
+    int n               = 0;
+    poll_ctlreq_t *reqs = NULL;
+    int failed          = 0;
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    n = (int)lua_objlen(L, 2);
+    lua_settop(L, 2);
+    for (int i = 1; i <= n; i++) {
+        poll_event_t *ev = NULL;
+
+        lua_rawgeti(L, 2, i);
+        ev = toanyevent(L, -1);
+        if (!ev || ev->p != p) {
+            lua_pushfstring(L, "#%d is not an event of this instance", i);
+            return luaL_argerror(L, 2, lua_tostring(L, -1));
+        }
+        lua_pop(L, 1);
+    }
+    // buffer of the epoll_ctl requests that is released by the gc
+    reqs = lua_newuserdata(L, sizeof(poll_ctlreq_t) * (n ? n : 1));
+
+    failed = poll_unwatch_events(L, 2, reqs, n);
+    if (failed) {
+        int err = errno;
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(err));
+        lua_pushinteger(L, err);
+        lua_pushinteger(L, failed);
+        return 4;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+#ifdef EPIOCSPARAMS
+
+static int busy_poll_apply(poll_t *p)
+{
+    if (ioctl(p->fd, EPIOCSPARAMS, &p->busy_poll_params) == -1) {
+        if (errno == ENOTTY) {
+            // kernel does not support busy poll parameters
+            errno = ENOTSUP;
+        }
+        return POLL_ERROR;
+    }
+    return POLL_OK;
+}
+
+static int set_busy_poll_lua(lua_State *L)
+{
+    poll_t *p                  = luaL_checkudata(L, 1, POLL_MT);
+    struct epoll_params params = p->busy_poll_params;
+    lua_Integer usecs          = 0;
+    lua_Integer budget         = 0;
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_getfield(L, 2, "usecs");
+    usecs = luaL_optinteger(L, -1, 0);
+    lua_getfield(L, 2, "budget");
+    budget = luaL_optinteger(L, -1, 0);
+    lua_getfield(L, 2, "prefer");
+    if (usecs < 0 || usecs > INT32_MAX) {
+        return luaL_argerror(L, 2, "usecs must be in range 0 to INT32_MAX");
+    } else if (budget < 0 || budget > UINT16_MAX) {
+        return luaL_argerror(L, 2, "budget must be in range 0 to UINT16_MAX");
+    }
+
+    p->busy_poll_params = (struct epoll_params){
+        .busy_poll_usecs  = (uint32_t)usecs,
+        .busy_poll_budget = (uint16_t)budget,
+        .prefer_busy_poll = lua_toboolean(L, -1),
+    };
+    if (busy_poll_apply(p) != POLL_OK) {
+        // restore previous parameters
+        p->busy_poll_params = params;
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+    // NOTE: parameters will be applied again when the epoll is renewed
+    p->busy_poll = 1;
+
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int get_busy_poll_lua(lua_State *L)
+{
+    poll_t *p                  = luaL_checkudata(L, 1, POLL_MT);
+    struct epoll_params params = {0};
+
+    if (ioctl(p->fd, EPIOCGPARAMS, &params) == -1) {
+        if (errno == ENOTTY) {
+            // kernel does not support busy poll parameters
+            errno = ENOTSUP;
+        }
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    lua_createtable(L, 0, 3);
+    lua_pushinteger(L, params.busy_poll_usecs);
+    lua_setfield(L, -2, "usecs");
+    lua_pushinteger(L, params.busy_poll_budget);
+    lua_setfield(L, -2, "budget");
+    lua_pushboolean(L, params.prefer_busy_poll);
+    lua_setfield(L, -2, "prefer");
+    return 1;
+}
+
+#else
+
+static int set_busy_poll_lua(lua_State *L)
+{
+    luaL_checkudata(L, 1, POLL_MT);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    errno = ENOTSUP;
+    lua_pushboolean(L, 0);
+    lua_pushstring(L, strerror(errno));
+    lua_pushinteger(L, errno);
+    return 3;
+}
+
+static int get_busy_poll_lua(lua_State *L)
+{
+    luaL_checkudata(L, 1, POLL_MT);
+    errno = ENOTSUP;
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    lua_pushinteger(L, errno);
+    return 3;
+}
+
+#endif
+
+static int set_fairness_lua(lua_State *L)
+{
+    static const struct {
+        const char *name;
+        int filter;
+    } filters[] = {
+        {"read",    EVFILT_READ   },
+        {"write",   EVFILT_WRITE  },
+        {"trigger", EVFILT_TRIGGER},
+        {"duplex",  EVFILT_DUPLEX },
+    };
+    poll_t *p                 = luaL_checkudata(L, 1, POLL_MT);
+    int quota[EVFILT_MAX + 1] = {0};
+    lua_Integer budget        = 0;
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+    lua_getfield(L, 2, "budget");
+    budget = luaL_optinteger(L, -1, 0);
+    if (budget < 0 || budget > INT_MAX) {
+        return luaL_argerror(L, 2, "budget must be in range 0 to INT_MAX");
+    }
+    lua_getfield(L, 2, "quota");
+    if (!lua_isnil(L, -1)) {
+        luaL_checktype(L, -1, LUA_TTABLE);
+        for (size_t i = 0; i < sizeof(filters) / sizeof(*filters); i++) {
+            lua_getfield(L, 4, filters[i].name);
+            lua_Integer n = luaL_optinteger(L, -1, 0);
+            if (n < 0 || n > INT_MAX) {
+                return luaL_argerror(L, 2,
+                                     "quota must be in range 0 to INT_MAX");
+            }
+            quota[filters[i].filter] = (int)n;
+            lua_pop(L, 1);
+        }
+    }
+    lua_getfield(L, 2, "rotate");
+
+    p->rotate = lua_toboolean(L, -1);
+    p->budget = (int)budget;
+    memcpy(p->quota, quota, sizeof(quota));
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int get_fairness_lua(lua_State *L)
+{
+    poll_t *p = luaL_checkudata(L, 1, POLL_MT);
+
+    lua_createtable(L, 0, 3);
+    lua_pushboolean(L, p->rotate);
+    lua_setfield(L, -2, "rotate");
+    lua_pushinteger(L, p->budget);
+    lua_setfield(L, -2, "budget");
+    lua_createtable(L, 0, 4);
+    lua_pushinteger(L, p->quota[EVFILT_READ]);
+    lua_setfield(L, -2, "read");
+    lua_pushinteger(L, p->quota[EVFILT_WRITE]);
+    lua_setfield(L, -2, "write");
+    lua_pushinteger(L, p->quota[EVFILT_TRIGGER]);
+    lua_setfield(L, -2, "trigger");
+    lua_pushinteger(L, p->quota[EVFILT_DUPLEX]);
+    lua_setfield(L, -2, "duplex");
+    lua_setfield(L, -2, "quota");
     return 1;
 }
 
@@ -258,10 +1236,86 @@ static int renew_lua(lua_State *L)
         p->fd = fd;
     }
 
+    // the registrations in the changelist mode are lost with the old fd
+    poll_changelist_reset(p);
+    // the deferred events are never reported by the new fd
+    p->ndefer = 0;
+
+    // renew the io_uring, the timerfd for the timer heap and the signalfd
+    if (poll_uring_renew(p) != POLL_OK || poll_timer_renew(p) != POLL_OK ||
+        poll_signal_renew(p) != POLL_OK) {
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+#ifdef EPIOCSPARAMS
+    // apply the busy poll parameters to the new epoll descriptor
+    if (p->busy_poll && busy_poll_apply(p) != POLL_OK) {
+        lua_pushboolean(L, 0);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+#endif
+
     lua_pushboolean(L, 1);
     return 1;
 }
 
+static int stats_lua(lua_State *L)
+{
+    poll_t *p           = luaL_checkudata(L, 1, POLL_MT);
+    int reset           = lua_toboolean(L, 2);
+    poll_stats_t *stats = &p->stats;
+
+    lua_createtable(L, 0, 12);
+    lua_pushinteger(L, (lua_Integer)stats->nwait);
+    lua_setfield(L, -2, "wait");
+    lua_pushnumber(L, (lua_Number)stats->wait_ns / 1000000000);
+    lua_setfield(L, -2, "wait_time");
+    lua_pushinteger(L, (lua_Integer)stats->nevent);
+    lua_setfield(L, -2, "events");
+    lua_createtable(L, POLL_STATS_NHIST, 0);
+    for (int i = 0; i < POLL_STATS_NHIST; i++) {
+        lua_pushinteger(L, (lua_Integer)stats->hist[i]);
+        lua_rawseti(L, -2, i + 1);
+    }
+    lua_setfield(L, -2, "histogram");
+    lua_pushinteger(L, (lua_Integer)stats->nskip);
+    lua_setfield(L, -2, "skipped");
+    lua_pushinteger(L, (lua_Integer)stats->nintr);
+    lua_setfield(L, -2, "interrupted");
+    lua_pushinteger(L, (lua_Integer)stats->nctl_add);
+    lua_setfield(L, -2, "ctl_add");
+    lua_pushinteger(L, (lua_Integer)stats->nctl_mod);
+    lua_setfield(L, -2, "ctl_mod");
+    lua_pushinteger(L, (lua_Integer)stats->nctl_del);
+    lua_setfield(L, -2, "ctl_del");
+    lua_pushinteger(L, (lua_Integer)stats->nctl_cancel);
+    lua_setfield(L, -2, "ctl_cancelled");
+    lua_pushinteger(L, (lua_Integer)stats->nread);
+    lua_setfield(L, -2, "drain_read");
+
+    if (reset) {
+        *stats = (poll_stats_t){0};
+    }
+    return 1;
+}
+
+static int backend_lua(lua_State *L)
+{
+    poll_t *p = luaL_checkudata(L, 1, POLL_MT);
+
+    if (p->uring) {
+        lua_pushliteral(L, "io_uring");
+    } else {
+        lua_pushliteral(L, "epoll");
+    }
+    return 1;
+}
+
 static int len_lua(lua_State *L)
 {
     poll_t *p = luaL_checkudata(L, 1, POLL_MT);
@@ -280,32 +1334,88 @@ static int gc_lua(lua_State *L)
     poll_t *p = lua_touserdata(L, 1);
 
     close(p->fd);
-    unref(L, p->ref_evset);
-    unref(L, p->ref_evset_read);
-    unref(L, p->ref_evset_write);
-    unref(L, p->ref_evset_signal);
     unref(L, p->ref_evset_timer);
-    unref(L, p->ref_evset_trigger);
-    unref(L, p->ref_evlist);
+    free(p->evlist);
+    p->evlist = NULL;
+    p->evsize = 0;
+    free(p->fdset);
+    p->fdset  = NULL;
+    p->fdsize = 0;
+    poll_timer_free(p);
+    poll_signal_free(p);
+    poll_uring_free(p);
+    poll_changelist_free(p);
 
     return 0;
 }
 
+// get the positive integer option value
+static int checkopt_size(lua_State *L, const char *name, int def)
+{
+    int size = def;
+
+    lua_getfield(L, 1, name);
+    if (!lua_isnil(L, -1)) {
+        if (!lua_isnumber(L, -1) || lua_tointeger(L, -1) < 1 ||
+            lua_tointeger(L, -1) > INT_MAX) {
+            return luaL_argerror(
+                L, 1, lua_pushfstring(L, "%s must be positive integer", name));
+        }
+        size = (int)lua_tointeger(L, -1);
+    }
+    lua_pop(L, 1);
+    return size;
+}
+
 static int new_lua(lua_State *L)
 {
-    poll_t *p = lua_newuserdata(L, sizeof(poll_t));
+    int use_uring  = 0;
+    int changelist = 0;
+    int exclusive  = 0;
+    int capacity   = 0;
+    int maxevents  = POLL_MAXEVENTS;
+    poll_t *p      = NULL;
 
+    // check options
+    if (!lua_isnoneornil(L, 1)) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        lua_getfield(L, 1, "backend");
+        if (!lua_isnil(L, -1)) {
+            const char *backend = lua_tostring(L, -1);
+            if (lua_type(L, -1) != LUA_TSTRING ||
+                (strcmp(backend, "epoll") && strcmp(backend, "io_uring"))) {
+                return luaL_argerror(L, 1,
+                                     "backend must be 'epoll' or 'io_uring'");
+            }
+            use_uring = strcmp(backend, "io_uring") == 0;
+        }
+        lua_pop(L, 1);
+        lua_getfield(L, 1, "changelist");
+        changelist = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, 1, "exclusive");
+        exclusive = lua_toboolean(L, -1);
+        lua_pop(L, 1);
+        capacity  = checkopt_size(L, "capacity", 0);
+        maxevents = checkopt_size(L, "maxevents", POLL_MAXEVENTS);
+    }
+
+    p  = lua_newuserdata(L, sizeof(poll_t));
     *p = (poll_t){
         // create poll descriptor
-        .fd                = poll_open(),
-        .ref_evset         = LUA_NOREF,
-        .ref_evset_read    = LUA_NOREF,
-        .ref_evset_write   = LUA_NOREF,
-        .ref_evset_signal  = LUA_NOREF,
-        .ref_evset_timer   = LUA_NOREF,
-        .ref_evset_trigger = LUA_NOREF,
-        .ref_evlist        = LUA_NOREF,
+        .fd              = poll_open(),
+        .uring           = NULL,
+        .ref_evset_timer = LUA_NOREF,
+        .evmin           = POLL_EVLIST_MIN,
+        .maxevents       = maxevents,
+        .evlist          = NULL,
+        .fdset           = NULL,
+        .signalfd        = -1,
+        .timerfd         = -1,
+        .changelist      = changelist,
+        .exclusive       = exclusive,
     };
+    sigemptyset(&p->sigset);
 
     if (p->fd == -1) {
         // got error
@@ -317,23 +1427,40 @@ static int new_lua(lua_State *L)
     luaL_getmetatable(L, POLL_MT);
     lua_setmetatable(L, -2);
 
-    // create evset tables
-    lua_newtable(L);
-    p->ref_evset = getref(L);
-    lua_newtable(L);
-    p->ref_evset_read = getref(L);
-    lua_newtable(L);
-    p->ref_evset_write = getref(L);
-    lua_newtable(L);
-    p->ref_evset_signal = getref(L);
+    // NOTE: fallback to the epoll_ctl if io_uring is not available
+    if (use_uring) {
+        poll_uring_open(p);
+    }
+
+    // preallocate the event list and the event table
+    if (capacity) {
+        p->evmin = capacity;
+    }
+    if (p->evmin > p->maxevents) {
+        p->evmin = p->maxevents;
+    }
+    if (evlist_resize(p, p->evmin) != POLL_OK ||
+        poll_evset_reserve(p, capacity) != POLL_OK) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
+
+    // create evset table for timer identifiers
     lua_newtable(L);
     p->ref_evset_timer = getref(L);
-    lua_newtable(L);
-    p->ref_evset_trigger = getref(L);
 
     return 1;
 }
 
+static int clock_lua(lua_State *L)
+{
+    // monotonic time in seconds
+    lua_pushnumber(L, (lua_Number)poll_gettime() / 1000000000);
+    return 1;
+}
+
 static int usable_lua(lua_State *L)
 {
     lua_pushboolean(L, 1);
@@ -349,11 +1476,45 @@ LUALIB_API int luaopen_epoll(lua_State *L)
         {NULL,         NULL        }
     };
     struct luaL_Reg method[] = {
-        {"renew",     renew_lua    },
-        {"new_event", new_event_lua},
-        {"wait",      wait_lua     },
-        {"consume",   consume_lua  },
-        {NULL,        NULL         }
+        {"renew",         renew_lua        },
+        {"backend",       backend_lua      },
+        {"set_busy_poll", set_busy_poll_lua},
+        {"get_busy_poll", get_busy_poll_lua},
+        {"set_fairness",  set_fairness_lua },
+        {"get_fairness",  get_fairness_lua },
+        {"stats",         stats_lua        },
+        {"new_event",     new_event_lua    },
+        {"watch_many",    watch_many_lua   },
+        {"unwatch_many",  unwatch_many_lua },
+        {"wait",          wait_lua         },
+        {"wait_until",    wait_until_lua   },
+        {"consume",       consume_lua      },
+        {"dispatch",      dispatch_lua     },
+        {"run",           run_lua          },
+        {"run_once",      run_once_lua     },
+        {"stop",          stop_lua         },
+        {NULL,            NULL             }
+    };
+    struct evbit_t {
+        const char *name;
+        lua_Integer bit;
+    } evbits[] = {
+        {"EPOLLIN",        EPOLLIN       },
+        {"EPOLLPRI",       EPOLLPRI      },
+        {"EPOLLOUT",       EPOLLOUT      },
+        {"EPOLLERR",       EPOLLERR      },
+        {"EPOLLHUP",       EPOLLHUP      },
+        {"EPOLLRDHUP",     EPOLLRDHUP    },
+        {"EPOLLRDNORM",    EPOLLRDNORM   },
+        {"EPOLLRDBAND",    EPOLLRDBAND   },
+        {"EPOLLWRNORM",    EPOLLWRNORM   },
+        {"EPOLLWRBAND",    EPOLLWRBAND   },
+        {"EPOLLMSG",       EPOLLMSG      },
+        {"EPOLLEXCLUSIVE", EPOLLEXCLUSIVE},
+        {"EPOLLWAKEUP",    EPOLLWAKEUP   },
+        {"EPOLLONESHOT",   EPOLLONESHOT  },
+        {"EPOLLET",        EPOLLET       },
+        {NULL,             0             }
     };
 
     libopen_poll_event(L);
@@ -362,6 +1523,7 @@ LUALIB_API int luaopen_epoll(lua_State *L)
     libopen_poll_signal(L);
     libopen_poll_timer(L);
     libopen_poll_trigger(L);
+    libopen_poll_duplex(L);
 
     // create metatable
     luaL_newmetatable(L, POLL_MT);
@@ -385,6 +1547,13 @@ LUALIB_API int luaopen_epoll(lua_State *L)
     lua_setfield(L, -2, "new");
     lua_pushcfunction(L, usable_lua);
     lua_setfield(L, -2, "usable");
+    lua_pushcfunction(L, clock_lua);
+    lua_setfield(L, -2, "clock");
+    // export the event bits that are returned by ev:events() and ev:revents()
+    for (struct evbit_t *ptr = evbits; ptr->name; ptr++) {
+        lua_pushinteger(L, ptr->bit);
+        lua_setfield(L, -2, ptr->name);
+    }
 
     return 1;
 }
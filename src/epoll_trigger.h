@@ -0,0 +1,130 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * C API to fire the epoll.trigger event from the native threads.
+ *
+ * the handle that is returned by the `ev:handle()` method of the
+ * epoll.trigger instance is a pointer to the poll_trigger_t. it is valid while
+ * the event instance is alive, so the native code should retain it by
+ * poll_trigger_retain() before passing it to the other threads, and release
+ * it by poll_trigger_release() when it is no longer used.
+ *
+ *  void *handle = lua_touserdata(L, idx);
+ *  poll_trigger_t *trigger = poll_trigger_retain(handle);
+ *  // in the worker thread
+ *  poll_trigger_signal(trigger);
+ *  poll_trigger_release(trigger);
+ *
+ * this header is self-contained and does not require linking to the module.
+ */
+
+#ifndef epoll_trigger_h
+#define epoll_trigger_h
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    int fd;        // eventfd
+    int semaphore; // eventfd is created with EFD_SEMAPHORE
+    int pending;   // wakeup is pending and has not been drained yet
+    int nref;      // reference counter
+} poll_trigger_t;
+
+static inline poll_trigger_t *poll_trigger_retain(poll_trigger_t *trigger)
+{
+    __atomic_add_fetch(&trigger->nref, 1, __ATOMIC_RELAXED);
+    return trigger;
+}
+
+static inline void poll_trigger_release(poll_trigger_t *trigger)
+{
+    if (__atomic_sub_fetch(&trigger->nref, 1, __ATOMIC_ACQ_REL) == 0) {
+        close(trigger->fd);
+        free(trigger);
+    }
+}
+
+/**
+ * wake the loop that watches the trigger. it is safe to call from any thread.
+ * the signals while the wakeup is already pending are coalesced without
+ * calling write(), except for the semaphore mode trigger that counts every
+ * signal. returns 0 on success, or -1 on failure and errno is set.
+ */
+static inline int poll_trigger_signal(poll_trigger_t *trigger)
+{
+    uint64_t val = 1;
+
+    if (!trigger->semaphore &&
+        __atomic_exchange_n(&trigger->pending, 1, __ATOMIC_ACQ_REL)) {
+        // wakeup is already pending
+        return 0;
+    }
+
+    while (write(trigger->fd, &val, sizeof(val)) == -1) {
+        if (errno != EINTR) {
+            __atomic_store_n(&trigger->pending, 0, __ATOMIC_RELEASE);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * clear the pending flag. the signals after this call will wake the loop
+ * again, so it must be called before the eventfd is drained.
+ */
+static inline void poll_trigger_clear(poll_trigger_t *trigger)
+{
+    __atomic_store_n(&trigger->pending, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * drain the eventfd in the loop that watches the trigger and store the
+ * counter value to val. the pending flag is cleared before the eventfd is
+ * drained, and if a signal has raced with the drain, the loop is woken again
+ * since the write of that signal may have been drained. returns 0 on
+ * success, or -1 on failure and errno is set.
+ */
+static inline int poll_trigger_drain(poll_trigger_t *trigger, uint64_t *val)
+{
+    uint64_t one = 1;
+
+    poll_trigger_clear(trigger);
+    if (read(trigger->fd, val, sizeof(*val)) == -1) {
+        return -1;
+    } else if (!trigger->semaphore &&
+               __atomic_load_n(&trigger->pending, __ATOMIC_ACQUIRE)) {
+        // NOTE: it may cause a spurious wakeup, but never loses the signal
+        while (write(trigger->fd, &one, sizeof(one)) == -1) {
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+#endif
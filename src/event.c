@@ -54,6 +54,11 @@ static int is_level_lua(lua_State *L)
     return poll_event_is_level_lua(L, MODULE_MT);
 }
 
+static int priority_lua(lua_State *L)
+{
+    return poll_event_priority_lua(L, MODULE_MT);
+}
+
 static int renew_lua(lua_State *L)
 {
     return poll_event_renew_lua(L, MODULE_MT);
@@ -91,11 +96,13 @@ void libopen_poll_event(lua_State *L)
         {"as_edge",    as_edge_lua     },
         {"is_oneshot", is_oneshot_lua  },
         {"as_oneshot", as_oneshot_lua  },
+        {"priority",   priority_lua    },
         {"as_read",    poll_raed_new   },
         {"as_write",   poll_write_new  },
         {"as_signal",  poll_signal_new },
         {"as_timer",   poll_timer_new  },
         {"as_trigger", poll_trigger_new},
+        {"as_duplex",  poll_duplex_new },
         {NULL,         NULL            }
     };
 
@@ -24,12 +24,14 @@
 #define lua_epoll_h
 
 #include "config.h"
+#include "epoll_trigger.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/epoll.h>
+#include <time.h>
 #include <unistd.h>
 // lualib
 #include <lauxlib.h>
@@ -56,6 +58,25 @@ static inline void pushref(lua_State *L, int ref)
     lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
 }
 
+// resume the coroutine and get the number of values that are yielded or
+// returned by the coroutine
+static inline int poll_resume(lua_State *co, lua_State *from, int narg,
+                              int *nres)
+{
+#if LUA_VERSION_NUM >= 504
+    return lua_resume(co, from, narg, nres);
+#else
+# if LUA_VERSION_NUM >= 502
+    int status = lua_resume(co, from, narg);
+# else
+    int status = lua_resume(co, narg);
+    (void)from;
+# endif
+    *nres = lua_gettop(co);
+    return status;
+#endif
+}
+
 #if HAVE_EPOLL_CREATE1
 # define poll_open() epoll_create1(EPOLL_CLOEXEC)
 #else
@@ -67,6 +88,8 @@ static inline void pushref(lua_State *L, int ref)
 #define EVFILT_SIGNAL  0x3
 #define EVFILT_TIMER   0x4
 #define EVFILT_TRIGGER 0x5
+#define EVFILT_DUPLEX  0x6
+#define EVFILT_MAX     EVFILT_DUPLEX
 
 #define EV_CLEAR   EPOLLET
 #define EV_ONESHOT EPOLLONESHOT
@@ -77,34 +100,180 @@ static inline void pushref(lua_State *L, int ref)
 # define EPOLLEXCLUSIVE 0x0
 #endif
 
+#if HAVE_LINUX_EVENTPOLL_H && !defined(EPIOCSPARAMS)
+// NOTE: busy poll parameters are available since linux 6.9. define them if
+// the libc does not provide them.
+# include <sys/ioctl.h>
+struct epoll_params {
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad; // pad the struct to a multiple of 64bits
+};
+# define EPOLL_IOC_TYPE 0x8A
+# define EPIOCSPARAMS   _IOW(EPOLL_IOC_TYPE, 0x01, struct epoll_params)
+# define EPIOCGPARAMS   _IOR(EPOLL_IOC_TYPE, 0x02, struct epoll_params)
+#endif
+
 typedef struct epoll_event event_t;
 
+typedef struct poll_event poll_event_t;
+typedef struct poll_uring poll_uring_t;
+
+#define EVFILT_BIT(filter) (1 << (filter))
+
+typedef struct {
+    uint64_t deadline; // absolute expiration time in nanoseconds
+    uint64_t interval; // interval time in nanoseconds
+    int idx;           // index in the timer heap, or -1 if not scheduled
+    poll_event_t *ev;
+} poll_timer_t;
+
+typedef struct {
+    poll_event_t *ev; // event registered with the fd
+    int filters;      // bits of filters registered with the fd as ident
+    // registration state of the fd in the changelist mode
+    uint8_t kreg;    // fd is registered with the kernel
+    uint8_t changed; // fd has the deferred changes
+    uint8_t reg;     // fd should be added or modified
+    event_t evt;     // event to be registered with the kernel
+    event_t kevt;    // event registered with the kernel
+} poll_fdslot_t;
+
+// epoll_ctl request that is submitted in a batch
 typedef struct {
+    int op;
     int fd;
-    int ref_evset;
-    int ref_evset_read;
-    int ref_evset_write;
-    int ref_evset_signal;
+    event_t *evt;
+    int res; // 0 on success, or negative errno
+    int idx; // index of the event in the list of the caller
+} poll_ctlreq_t;
+
+#define POLL_FDSET_MIN 64
+
+// number of buckets of the histogram of events per wait
+#define POLL_STATS_NHIST 16
+
+typedef struct {
+    uint64_t nwait;   // number of wait calls
+    uint64_t wait_ns; // total time blocked in the kernel in nanoseconds
+    uint64_t nevent;  // total number of events returned by the kernel
+    // number of wait calls by the number of events: hist[0] is 0 event and
+    // hist[i] is 2^(i-1) to 2^i-1 events. the last bucket has no upper bound.
+    uint64_t hist[POLL_STATS_NHIST];
+    uint64_t nskip; // events skipped since they were unwatched or disarmed
+    uint64_t nintr; // wakeups by EINTR or ENOENT
+    uint64_t nctl_add;
+    uint64_t nctl_mod;
+    uint64_t nctl_del;
+    uint64_t nctl_cancel; // requests cancelled in the changelist mode
+    uint64_t nread; // drain read() calls of the occurred events
+} poll_stats_t;
+
+// default size, cap and shrink policy of the event list
+#define POLL_EVLIST_MIN          16
+#define POLL_MAXEVENTS           1024
+#define POLL_EVLIST_SHRINK_WAITS 16
+
+// number of the priority classes of the event delivery
+#define POLL_NPRIO 4
+
+typedef struct {
+    int fd;
+    poll_uring_t *uring; // io_uring to submit the epoll_ctl requests
+    int exclusive;       // read events are registered with EPOLLEXCLUSIVE
+#ifdef EPIOCSPARAMS
+    int busy_poll; // busy poll parameters are set
+    struct epoll_params busy_poll_params;
+#endif
     int ref_evset_timer;
-    int ref_evset_trigger;
-    int ref_evlist;
     int nreg;
     int nevt;
     int cur;
+    // event list that is resized by the number of events of each wait
     int evsize;
+    int evmin;     // lower bound of the evsize
+    int maxevents; // upper bound of the number of events of each wait
+    int nshrink;   // number of consecutive waits that use less than 1/4
     event_t *evlist;
+    int fdsize;
+    poll_fdslot_t *fdset; // fd-indexed event table
+    uint32_t evgen;       // generation counter of the registrations
+    // registered signals multiplexed onto a single signalfd
+    int signalfd;
+    sigset_t sigset;
+    poll_event_t *sigevs[NSIG];
+    // timer heap multiplexed onto a single timerfd
+    int timerfd;
+    uint64_t timerfd_deadline; // deadline that the timerfd is armed for
+    uint64_t waited_at;        // time when the last wait returned
+    int ntimer;
+    int timersize;
+    poll_timer_t **timers; // 4-ary min-heap ordered by deadline
+    // occurred events that are not reported by the kernel directly
+    int npending;
+    poll_event_t *pending_head;
+    poll_event_t *pending_tail;
+    int nawait;   // number of coroutines awaiting the events
+    int nhandler; // number of events that have the handler
+    int nprio;    // number of events that have the non-zero priority
+    int stopped;  // ep:stop() has been called
+    // fairness controls of the event consumption
+    int rotate;                   // rotate the consumption order of events
+    uint32_t evrot;               // rotation counter
+    int budget;                   // max events handed out by each wait
+    int ndefer;                   // events deferred to the next wait
+    int quota[EVFILT_MAX + 1];    // max events per filter of each wait
+    int nconsume[EVFILT_MAX + 1]; // events consumed per filter
+    // registration changes that are deferred until the next wait
+    int changelist; // changelist mode is enabled
+    int nchange;
+    int changesize;
+    int nrecord;            // number of the recorded requests
+    int *changes;           // fds that have the deferred changes
+    poll_ctlreq_t *chgreqs; // requests to apply the changes
+    poll_stats_t stats;
 } poll_t;
 
-typedef struct {
+struct poll_event {
     poll_t *p;
     int ref_poll;
+    int ref_self; // reference to itself while registered
     int ref_udata;
+    int ref_co;      // coroutine awaiting the event
+    int ref_handler; // handler that is called by ep:run()
+    int timedout;    // await of the event has timed out
+    int idled;       // idle timeout of the event has expired
     int enabled;
+    int disarmed;  // oneshot event that keeps its kernel registration
+    int ctl_errno; // error of the deferred registration
     int ident;
     int filter;
+    int prio;        // priority class of the delivery
     event_t reg_evt; // registered event
     event_t occ_evt; // occurred event
-} poll_event_t;
+    // data of the occurred event that is read while draining the event
+    uint64_t occ_data; // number of timer expirations, trigger counter value
+                       // or number of received signals
+    int32_t occ_pid;   // siginfo of the last received signal
+    int32_t occ_status;
+    int32_t occ_code;
+    poll_timer_t timer;
+    // inactivity timeout that is extended lazily by the activity
+    poll_timer_t idle;
+    uint64_t idle_at;        // time of the last activity
+    poll_trigger_t *trigger; // eventfd of the trigger event
+    int pending;
+    poll_event_t *pending_prev;
+    poll_event_t *pending_next;
+};
+
+static inline uint64_t poll_gettime(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
 
 #define POLL_MT         "epoll"
 #define POLL_EVENT_MT   "epoll.event"
@@ -113,6 +282,7 @@ typedef struct {
 #define POLL_SIGNAL_MT  "epoll.signal"
 #define POLL_TIMER_MT   "epoll.timer"
 #define POLL_TRIGGER_MT "epoll.trigger"
+#define POLL_DUPLEX_MT  "epoll.duplex"
 
 void libopen_poll_event(lua_State *L);
 void libopen_poll_read(lua_State *L);
@@ -120,20 +290,140 @@ void libopen_poll_write(lua_State *L);
 void libopen_poll_signal(lua_State *L);
 void libopen_poll_timer(lua_State *L);
 void libopen_poll_trigger(lua_State *L);
+void libopen_poll_duplex(lua_State *L);
 
 int poll_raed_new(lua_State *L);
 int poll_write_new(lua_State *L);
+int poll_read_prepare(lua_State *L, poll_event_t *ev, int fd);
+int poll_write_prepare(lua_State *L, poll_event_t *ev, int fd);
 int poll_signal_new(lua_State *L);
 int poll_timer_new(lua_State *L);
 int poll_trigger_new(lua_State *L);
+int poll_duplex_new(lua_State *L);
 
 int poll_event_gc_lua(lua_State *L);
 int poll_event_tostring_lua(lua_State *L, const char *tname);
 int poll_event_renew_lua(lua_State *L, const char *tname);
 int poll_event_revert_lua(lua_State *L, const char *tname);
 
-int poll_evset_getflag(lua_State *L, int ref_filter_evset, int ident);
-poll_event_t *poll_evset_get(lua_State *L, poll_t *p, event_t *evt);
+int poll_timer_add(poll_t *p, poll_event_t *ev);
+int poll_timer_timeout(poll_t *p, poll_event_t *ev, uint64_t nsec);
+void poll_timer_del(poll_t *p, poll_event_t *ev);
+int poll_timer_idle_add(poll_t *p, poll_event_t *ev);
+void poll_timer_idle_del(poll_t *p, poll_event_t *ev);
+int poll_timer_expire(poll_t *p);
+int poll_timer_renew(poll_t *p);
+void poll_timer_free(poll_t *p);
+
+int poll_signal_watch(poll_t *p, poll_event_t *ev);
+int poll_signal_unwatch(poll_t *p, poll_event_t *ev);
+int poll_signal_read(poll_t *p);
+int poll_signal_renew(poll_t *p);
+void poll_signal_free(poll_t *p);
+
+int poll_uring_open(poll_t *p);
+void poll_uring_ctl_batch(poll_t *p, poll_ctlreq_t *reqs, int n);
+
+int poll_changelist_add(poll_t *p, int op, int fd, event_t *evt);
+int poll_changelist_flush(poll_t *p);
+void poll_changelist_reset(poll_t *p);
+void poll_changelist_free(poll_t *p);
+int poll_uring_renew(poll_t *p);
+void poll_uring_free(poll_t *p);
+int poll_uring_interrupted(void);
+
+// control the interest list of the epoll instance through the backend
+static inline int poll_ctl(poll_t *p, int op, int fd, event_t *evt)
+{
+    switch (op) {
+    case EPOLL_CTL_ADD:
+        p->stats.nctl_add++;
+        break;
+    case EPOLL_CTL_MOD:
+        p->stats.nctl_mod++;
+        break;
+    case EPOLL_CTL_DEL:
+        p->stats.nctl_del++;
+        break;
+    }
+
+    // NOTE: a single request is not submitted through the io_uring since it
+    // costs the same syscall as the epoll_ctl
+    return epoll_ctl(p->fd, op, fd, evt);
+}
+
+// submit the epoll_ctl requests at once. the result of each request is set
+// to the res field.
+static inline void poll_ctl_batch(poll_t *p, poll_ctlreq_t *reqs, int n)
+{
+    for (int i = 0; i < n; i++) {
+        switch (reqs[i].op) {
+        case EPOLL_CTL_ADD:
+            p->stats.nctl_add++;
+            break;
+        case EPOLL_CTL_MOD:
+            p->stats.nctl_mod++;
+            break;
+        case EPOLL_CTL_DEL:
+            p->stats.nctl_del++;
+            break;
+        }
+    }
+
+    if (p->uring && n > 1) {
+        poll_uring_ctl_batch(p, reqs, n);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        poll_ctlreq_t *req = reqs + i;
+        req->res           = 0;
+        if (epoll_ctl(p->fd, req->op, req->fd, req->evt) == -1) {
+            req->res = -errno;
+        }
+    }
+}
+
+// control the registration of the event. in the changelist mode, the add
+// and modify requests are deferred and merged with the other requests of the
+// same fd until the next wait.
+static inline int poll_evctl(poll_t *p, int op, int fd, event_t *evt)
+{
+    if (p->changelist && fd >= 0 && fd < p->fdsize) {
+        return poll_changelist_add(p, op, fd, evt);
+    }
+    return poll_ctl(p, op, fd, evt);
+}
+
+static inline void poll_evctl_batch(poll_t *p, poll_ctlreq_t *reqs, int n)
+{
+    if (!p->changelist) {
+        poll_ctl_batch(p, reqs, n);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        poll_ctlreq_t *req = reqs + i;
+        req->res           = 0;
+        if (poll_evctl(p, req->op, req->fd, req->evt) == -1) {
+            req->res = -errno;
+        }
+    }
+}
+
+// the epoll_data of the registered event holds the fd in the first 4 bytes
+// and the generation of the registration in the last 4 bytes.
+static inline void poll_evdata_setgen(event_t *evt, uint32_t gen)
+{
+    memcpy((char *)&evt->data + sizeof(evt->data.fd), &gen, sizeof(gen));
+}
+
+void poll_pending_add(poll_t *p, poll_event_t *ev);
+void poll_pending_del(poll_t *p, poll_event_t *ev);
+poll_event_t *poll_pending_shift(poll_t *p);
+
+int poll_evset_getflag(lua_State *L, poll_t *p, int filter, int ident);
+poll_event_t *poll_evset_get(poll_t *p, event_t *evt);
+int poll_evset_reserve(poll_t *p, int size);
+int poll_evset_add(lua_State *L, poll_event_t *ev, int poll_event_idx);
 void poll_evset_del(lua_State *L, poll_event_t *ev);
 
 #define POLL_ERROR    -1
@@ -142,6 +432,13 @@ void poll_evset_del(lua_State *L, poll_event_t *ev);
 
 int poll_watch_event(lua_State *L, poll_event_t *ev, int poll_event_idx);
 int poll_unwatch_event(lua_State *L, poll_event_t *ev);
+int poll_watch_events(lua_State *L, int idx, poll_ctlreq_t *reqs, int n);
+int poll_unwatch_events(lua_State *L, int idx, poll_ctlreq_t *reqs, int n);
+int poll_disarm_event(lua_State *L, poll_event_t *ev);
+int poll_suspend_event(lua_State *L, poll_event_t *ev);
+void poll_detach_event(poll_event_t *ev);
+void poll_await_cancel(lua_State *L, poll_event_t *ev);
+void poll_handler_release(lua_State *L, poll_event_t *ev);
 
 int poll_event_watch_lua(lua_State *L, const char *tname);
 int poll_event_unwatch_lua(lua_State *L, const char *tname);
@@ -157,5 +454,11 @@ int poll_event_as_oneshot_lua(lua_State *L, const char *tname);
 int poll_event_ident_lua(lua_State *L, const char *tname);
 int poll_event_udata_lua(lua_State *L, const char *tname);
 int poll_event_getinfo_lua(lua_State *L, const char *tname);
+int poll_event_events_lua(lua_State *L, const char *tname);
+int poll_event_revents_lua(lua_State *L, const char *tname);
+int poll_event_await_lua(lua_State *L, const char *tname);
+int poll_event_on_lua(lua_State *L, const char *tname);
+int poll_event_priority_lua(lua_State *L, const char *tname);
+int poll_event_set_idle_timeout_lua(lua_State *L, const char *tname);
 
 #endif
@@ -29,6 +29,36 @@ static int getinfo_lua(lua_State *L)
     return poll_event_getinfo_lua(L, MODULE_MT);
 }
 
+static int events_lua(lua_State *L)
+{
+    return poll_event_events_lua(L, MODULE_MT);
+}
+
+static int revents_lua(lua_State *L)
+{
+    return poll_event_revents_lua(L, MODULE_MT);
+}
+
+static int await_lua(lua_State *L)
+{
+    return poll_event_await_lua(L, MODULE_MT);
+}
+
+static int on_lua(lua_State *L)
+{
+    return poll_event_on_lua(L, MODULE_MT);
+}
+
+static int priority_lua(lua_State *L)
+{
+    return poll_event_priority_lua(L, MODULE_MT);
+}
+
+static int set_idle_timeout_lua(lua_State *L)
+{
+    return poll_event_set_idle_timeout_lua(L, MODULE_MT);
+}
+
 static int udata_lua(lua_State *L)
 {
     return poll_event_udata_lua(L, MODULE_MT);
@@ -115,39 +145,52 @@ static int gc_lua(lua_State *L)
     return poll_event_gc_lua(L);
 }
 
-int poll_raed_new(lua_State *L)
+// prepare the event to watch the fd for reading. it returns POLL_ERROR with
+// errno if the fd cannot be watched.
+int poll_read_prepare(lua_State *L, poll_event_t *ev, int fd)
 {
-    poll_event_t *ev = luaL_checkudata(L, 1, POLL_EVENT_MT);
-    int fd           = luaL_checkinteger(L, 2);
-    int dupfd        = fd;
+    int dupfd = fd;
 
-    if (poll_evset_getflag(L, ev->p->ref_evset_read, fd)) {
-        // already registered
+    if (poll_evset_getflag(L, ev->p, EVFILT_READ, fd) ||
+        poll_evset_getflag(L, ev->p, EVFILT_DUPLEX, fd)) {
+        // already registered (or watched by the duplex event)
         errno = EEXIST;
-        lua_pushnil(L);
-        lua_pushstring(L, strerror(errno));
-        lua_pushinteger(L, errno);
-        return 3;
-    } else if (poll_evset_getflag(L, ev->p->ref_evset_write, fd)) {
+        return POLL_ERROR;
+    } else if (poll_evset_getflag(L, ev->p, EVFILT_WRITE, fd)) {
         // NOTE: epoll does not support to watch both read and write events on
         // the same fd. so, duplicate fd.
         dupfd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
         if (dupfd == -1) {
             // failed to duplicate fd
-            lua_pushnil(L);
-            lua_pushstring(L, strerror(errno));
-            lua_pushinteger(L, errno);
-            return 3;
+            return POLL_ERROR;
         }
     }
 
     ev->ident  = fd;
     ev->filter = EVFILT_READ;
     ev->reg_evt.events |= EPOLLIN;
+    if (ev->p->exclusive && !(ev->reg_evt.events & EV_ONESHOT)) {
+        // wake only one of the epoll instances that watch the same fd
+        ev->reg_evt.events |= EPOLLEXCLUSIVE;
+    }
     ev->reg_evt.data.fd = dupfd;
-    if (poll_watch_event(L, ev, 1) != POLL_OK) {
-        if (dupfd != fd) {
-            close(dupfd);
+    return POLL_OK;
+}
+
+int poll_raed_new(lua_State *L)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, POLL_EVENT_MT);
+    int fd           = luaL_checkinteger(L, 2);
+
+    if (poll_read_prepare(L, ev, fd) != POLL_OK) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    } else if (poll_watch_event(L, ev, 1) != POLL_OK) {
+        if (ev->reg_evt.data.fd != fd) {
+            close(ev->reg_evt.data.fd);
+            ev->reg_evt.data.fd = fd;
         }
         lua_pushnil(L);
         lua_pushstring(L, strerror(errno));
@@ -173,23 +216,30 @@ void libopen_poll_read(lua_State *L)
         {NULL,         NULL        }
     };
     struct luaL_Reg method[] = {
-        {"type",       type_lua      },
-        {"renew",      renew_lua     },
-        {"revert",     revert_lua    },
-        {"watch",      watch_lua     },
-        {"unwatch",    unwatch_lua   },
-        {"is_enabled", is_enabled_lua},
-        {"is_eof",     is_eof_lua    },
-        {"is_level",   is_level_lua  },
-        {"as_level",   as_level_lua  },
-        {"is_edge",    is_edge_lua   },
-        {"as_edge",    as_edge_lua   },
-        {"is_oneshot", is_oneshot_lua},
-        {"as_oneshot", as_oneshot_lua},
-        {"ident",      ident_lua     },
-        {"udata",      udata_lua     },
-        {"getinfo",    getinfo_lua   },
-        {NULL,         NULL          }
+        {"type",             type_lua            },
+        {"renew",            renew_lua           },
+        {"revert",           revert_lua          },
+        {"watch",            watch_lua           },
+        {"rearm",            watch_lua           },
+        {"unwatch",          unwatch_lua         },
+        {"is_enabled",       is_enabled_lua      },
+        {"is_eof",           is_eof_lua          },
+        {"is_level",         is_level_lua        },
+        {"as_level",         as_level_lua        },
+        {"is_edge",          is_edge_lua         },
+        {"as_edge",          as_edge_lua         },
+        {"is_oneshot",       is_oneshot_lua      },
+        {"as_oneshot",       as_oneshot_lua      },
+        {"ident",            ident_lua           },
+        {"udata",            udata_lua           },
+        {"getinfo",          getinfo_lua         },
+        {"events",           events_lua          },
+        {"revents",          revents_lua         },
+        {"await",            await_lua           },
+        {"on",               on_lua              },
+        {"priority",         priority_lua        },
+        {"set_idle_timeout", set_idle_timeout_lua},
+        {NULL,               NULL                }
     };
 
     // create metatable
@@ -30,6 +30,31 @@ static int getinfo_lua(lua_State *L)
     return poll_event_getinfo_lua(L, MODULE_MT);
 }
 
+static int events_lua(lua_State *L)
+{
+    return poll_event_events_lua(L, MODULE_MT);
+}
+
+static int revents_lua(lua_State *L)
+{
+    return poll_event_revents_lua(L, MODULE_MT);
+}
+
+static int await_lua(lua_State *L)
+{
+    return poll_event_await_lua(L, MODULE_MT);
+}
+
+static int on_lua(lua_State *L)
+{
+    return poll_event_on_lua(L, MODULE_MT);
+}
+
+static int priority_lua(lua_State *L)
+{
+    return poll_event_priority_lua(L, MODULE_MT);
+}
+
 static int udata_lua(lua_State *L)
 {
     return poll_event_udata_lua(L, MODULE_MT);
@@ -118,6 +143,113 @@ static int gc_lua(lua_State *L)
 
 static sigset_t ALL_SIGNALS;
 
+// update the signal mask of the signalfd
+static int signalfd_update(poll_t *p, sigset_t *mask)
+{
+    if (p->signalfd != -1) {
+        if (signalfd(p->signalfd, mask, 0) == -1) {
+            return POLL_ERROR;
+        }
+        return POLL_OK;
+    }
+
+    // create signalfd and register it with the epoll instance
+    int fd = signalfd(-1, mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (fd == -1) {
+        return POLL_ERROR;
+    }
+    event_t evt = {
+        .events  = EPOLLIN,
+        .data.fd = fd,
+    };
+    if (poll_ctl(p, EPOLL_CTL_ADD, fd, &evt) == -1) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return POLL_ERROR;
+    }
+    p->signalfd = fd;
+
+    return POLL_OK;
+}
+
+int poll_signal_watch(poll_t *p, poll_event_t *ev)
+{
+    // NOTE: the signal number has already been added to p->sigset
+    (void)ev;
+    return signalfd_update(p, &p->sigset);
+}
+
+int poll_signal_unwatch(poll_t *p, poll_event_t *ev)
+{
+    sigset_t mask = p->sigset;
+
+    sigdelset(&mask, ev->ident);
+    return signalfd_update(p, &mask);
+}
+
+int poll_signal_read(poll_t *p)
+{
+    struct signalfd_siginfo siginfo[16];
+    int n = 0;
+
+    while (1) {
+        ssize_t len = read(p->signalfd, siginfo, sizeof(siginfo));
+        p->stats.nread++;
+        if (len == -1) {
+            if (errno == EAGAIN) {
+                return n;
+            } else if (errno == EINTR) {
+                continue;
+            }
+            return POLL_ERROR;
+        }
+
+        // route the received signals to the registered events
+        size_t nsig = (size_t)len / sizeof(struct signalfd_siginfo);
+        for (size_t i = 0; i < nsig; i++) {
+            uint32_t signo   = siginfo[i].ssi_signo;
+            poll_event_t *ev = (signo < NSIG) ? p->sigevs[signo] : NULL;
+            if (!ev) {
+                continue;
+            } else if (!ev->pending) {
+                poll_pending_add(p, ev);
+                n++;
+            }
+            // count the received signals and keep the last siginfo
+            ev->occ_data++;
+            ev->occ_pid    = (int32_t)siginfo[i].ssi_pid;
+            ev->occ_status = siginfo[i].ssi_status;
+            ev->occ_code   = siginfo[i].ssi_code;
+        }
+
+        if (nsig < sizeof(siginfo) / sizeof(struct signalfd_siginfo)) {
+            // no more signals
+            return n;
+        }
+    }
+}
+
+int poll_signal_renew(poll_t *p)
+{
+    // NOTE: the signalfd is shared with the parent process after fork, so
+    // create a new one for the new epoll descriptor.
+    if (p->signalfd != -1) {
+        close(p->signalfd);
+        p->signalfd = -1;
+        return signalfd_update(p, &p->sigset);
+    }
+    return POLL_OK;
+}
+
+void poll_signal_free(poll_t *p)
+{
+    if (p->signalfd != -1) {
+        close(p->signalfd);
+        p->signalfd = -1;
+    }
+}
+
 int poll_signal_new(lua_State *L)
 {
     poll_event_t *ev = luaL_checkudata(L, 1, POLL_EVENT_MT);
@@ -132,7 +264,7 @@ int poll_signal_new(lua_State *L)
         return 3;
     }
 
-    if (poll_evset_getflag(L, ev->p->ref_evset_signal, signo)) {
+    if (poll_evset_getflag(L, ev->p, EVFILT_SIGNAL, signo)) {
         // already registered
         errno = EEXIST;
         lua_pushnil(L);
@@ -141,24 +273,12 @@ int poll_signal_new(lua_State *L)
         return 3;
     }
 
-    // create signal fd
-    sigset_t ss;
-    sigemptyset(&ss);
-    sigaddset(&ss, signo);
-    int fd = signalfd(-1, &ss, SFD_CLOEXEC);
-    if (fd == -1) {
-        lua_pushnil(L);
-        lua_pushstring(L, strerror(errno));
-        lua_pushinteger(L, errno);
-        return 3;
-    }
-
     ev->ident  = signo;
     ev->filter = EVFILT_SIGNAL;
     ev->reg_evt.events |= EPOLLIN;
-    ev->reg_evt.data.fd = fd;
+    // NOTE: signal event does not have its own descriptor
+    ev->reg_evt.data.fd = -1;
     if (poll_watch_event(L, ev, 1) != POLL_OK) {
-        close(fd);
         lua_pushnil(L);
         lua_pushstring(L, strerror(errno));
         lua_pushinteger(L, errno);
@@ -199,6 +319,11 @@ void libopen_poll_signal(lua_State *L)
         {"ident",      ident_lua     },
         {"udata",      udata_lua     },
         {"getinfo",    getinfo_lua   },
+        {"events",     events_lua    },
+        {"revents",    revents_lua   },
+        {"await",      await_lua     },
+        {"on",         on_lua        },
+        {"priority",   priority_lua  },
         {NULL,         NULL          }
     };
 
@@ -21,6 +21,7 @@
  */
 
 #include "lua_epoll.h"
+#include <stdlib.h>
 #include <sys/timerfd.h>
 
 #define MODULE_MT POLL_TIMER_MT
@@ -35,6 +36,31 @@ static int getinfo_lua(lua_State *L)
     return poll_event_getinfo_lua(L, MODULE_MT);
 }
 
+static int events_lua(lua_State *L)
+{
+    return poll_event_events_lua(L, MODULE_MT);
+}
+
+static int revents_lua(lua_State *L)
+{
+    return poll_event_revents_lua(L, MODULE_MT);
+}
+
+static int await_lua(lua_State *L)
+{
+    return poll_event_await_lua(L, MODULE_MT);
+}
+
+static int on_lua(lua_State *L)
+{
+    return poll_event_on_lua(L, MODULE_MT);
+}
+
+static int priority_lua(lua_State *L)
+{
+    return poll_event_priority_lua(L, MODULE_MT);
+}
+
 static int ident_lua(lua_State *L)
 {
     return poll_event_ident_lua(L, MODULE_MT);
@@ -116,6 +142,309 @@ static int gc_lua(lua_State *L)
     return poll_event_gc_lua(L);
 }
 
+#define TIMER_HEAP_ARITY 4
+#define TIMER_HEAP_MIN   64
+
+static inline void heap_set(poll_t *p, int idx, poll_timer_t *t)
+{
+    p->timers[idx] = t;
+    t->idx         = idx;
+}
+
+static void heap_sift_up(poll_t *p, int idx)
+{
+    poll_timer_t *t = p->timers[idx];
+
+    while (idx > 0) {
+        int parent = (idx - 1) / TIMER_HEAP_ARITY;
+        if (p->timers[parent]->deadline <= t->deadline) {
+            break;
+        }
+        heap_set(p, idx, p->timers[parent]);
+        idx = parent;
+    }
+    heap_set(p, idx, t);
+}
+
+static void heap_sift_down(poll_t *p, int idx)
+{
+    poll_timer_t *t = p->timers[idx];
+
+    while (1) {
+        int child = idx * TIMER_HEAP_ARITY + 1;
+        if (child >= p->ntimer) {
+            break;
+        }
+
+        // find the earliest child
+        int last = child + TIMER_HEAP_ARITY;
+        int min  = child;
+        if (last > p->ntimer) {
+            last = p->ntimer;
+        }
+        for (child++; child < last; child++) {
+            if (p->timers[child]->deadline < p->timers[min]->deadline) {
+                min = child;
+            }
+        }
+        if (p->timers[min]->deadline >= t->deadline) {
+            break;
+        }
+        heap_set(p, idx, p->timers[min]);
+        idx = min;
+    }
+    heap_set(p, idx, t);
+}
+
+static int heap_push(poll_t *p, poll_timer_t *t)
+{
+    if (p->ntimer == p->timersize) {
+        // grow timer heap
+        int size = (p->timersize) ? p->timersize * 2 : TIMER_HEAP_MIN;
+        poll_timer_t **timers =
+            realloc(p->timers, sizeof(poll_timer_t *) * size);
+        if (!timers) {
+            return POLL_ERROR;
+        }
+        p->timers    = timers;
+        p->timersize = size;
+    }
+    heap_set(p, p->ntimer++, t);
+    heap_sift_up(p, t->idx);
+    return POLL_OK;
+}
+
+static void heap_remove(poll_t *p, poll_timer_t *t)
+{
+    int idx = t->idx;
+
+    t->idx = -1;
+    if (idx != --p->ntimer) {
+        // move the last timer to the removed position
+        poll_timer_t *last = p->timers[p->ntimer];
+        heap_set(p, idx, last);
+        if (idx > 0 && p->timers[(idx - 1) / TIMER_HEAP_ARITY]->deadline >
+                           last->deadline) {
+            heap_sift_up(p, idx);
+        } else {
+            heap_sift_down(p, idx);
+        }
+    }
+}
+
+// arm the timerfd for the earliest deadline
+static int timer_arm(poll_t *p)
+{
+    uint64_t deadline = (p->ntimer) ? p->timers[0]->deadline : 0;
+
+    if (deadline == p->timerfd_deadline) {
+        // already armed
+        return POLL_OK;
+    } else if (p->timerfd == -1) {
+        if (!deadline) {
+            return POLL_OK;
+        }
+
+        // create timerfd and register it with the epoll instance
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (fd == -1) {
+            return POLL_ERROR;
+        }
+        event_t evt = {
+            .events  = EPOLLIN,
+            .data.fd = fd,
+        };
+        if (poll_ctl(p, EPOLL_CTL_ADD, fd, &evt) == -1) {
+            int err = errno;
+            close(fd);
+            errno = err;
+            return POLL_ERROR;
+        }
+        p->timerfd = fd;
+    }
+
+    // NOTE: zero value disarms the timerfd
+    struct itimerspec its = {0};
+    its.it_value.tv_sec   = deadline / 1000000000;
+    its.it_value.tv_nsec  = deadline % 1000000000;
+    if (timerfd_settime(p->timerfd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+        return POLL_ERROR;
+    }
+    p->timerfd_deadline = deadline;
+
+    return POLL_OK;
+}
+
+static int timer_schedule(poll_t *p, poll_timer_t *t, uint64_t nsec)
+{
+    t->deadline = poll_gettime() + nsec;
+    if (heap_push(p, t) != POLL_OK) {
+        return POLL_ERROR;
+    } else if (timer_arm(p) != POLL_OK) {
+        int err = errno;
+        heap_remove(p, t);
+        errno = err;
+        return POLL_ERROR;
+    }
+    return POLL_OK;
+}
+
+int poll_timer_add(poll_t *p, poll_event_t *ev)
+{
+    if (!ev->timer.interval) {
+        // timer that never expires
+        return POLL_OK;
+    }
+    return timer_schedule(p, &ev->timer, ev->timer.interval);
+}
+
+int poll_timer_timeout(poll_t *p, poll_event_t *ev, uint64_t nsec)
+{
+    // NOTE: the timer node of the event that is not a timer event is used
+    // for the timeout of ev:await()
+    if (ev->timer.idx != -1) {
+        heap_remove(p, &ev->timer);
+    }
+    return timer_schedule(p, &ev->timer, nsec);
+}
+
+void poll_timer_del(poll_t *p, poll_event_t *ev)
+{
+    if (ev->timer.idx != -1) {
+        heap_remove(p, &ev->timer);
+        // NOTE: the timerfd will be rearmed at the next expiration if it
+        // fails to rearm here.
+        timer_arm(p);
+    }
+}
+
+int poll_timer_idle_add(poll_t *p, poll_event_t *ev)
+{
+    if (!ev->idle.interval) {
+        // idle timeout is not set
+        return POLL_OK;
+    } else if (ev->idle.idx != -1) {
+        heap_remove(p, &ev->idle);
+    }
+    if (timer_schedule(p, &ev->idle, ev->idle.interval) != POLL_OK) {
+        return POLL_ERROR;
+    }
+    ev->idle_at = ev->idle.deadline - ev->idle.interval;
+    return POLL_OK;
+}
+
+void poll_timer_idle_del(poll_t *p, poll_event_t *ev)
+{
+    if (ev->idled) {
+        // discard the expiration that has not been consumed
+        ev->idled = 0;
+        poll_pending_del(p, ev);
+    }
+    if (ev->idle.idx != -1) {
+        heap_remove(p, &ev->idle);
+        timer_arm(p);
+    }
+}
+
+int poll_timer_expire(poll_t *p)
+{
+    uint64_t nexpires = 0;
+    int n             = 0;
+
+    // drain timerfd
+    p->stats.nread++;
+    if (read(p->timerfd, &nexpires, sizeof(nexpires)) == -1 &&
+        errno != EAGAIN) {
+        return POLL_ERROR;
+    }
+    p->timerfd_deadline = 0;
+
+    uint64_t now = poll_gettime();
+    while (p->ntimer && p->timers[0]->deadline <= now) {
+        poll_timer_t *t  = p->timers[0];
+        poll_event_t *ev = t->ev;
+        uint64_t count   = 1;
+
+        if (t == &ev->idle) {
+            uint64_t deadline = ev->idle_at + t->interval;
+            if (deadline > now) {
+                // NOTE: the activity only updates the idle_at, so the
+                // deadline is extended here instead of on each activity
+                t->deadline = deadline;
+            } else {
+                // report it again if the event is still idle
+                t->deadline = now + t->interval;
+                // NOTE: if the event is already pending for another reason,
+                // the expiration is reported after that.
+                ev->idled   = 1;
+                if (!ev->pending) {
+                    poll_pending_add(p, ev);
+                    n++;
+                }
+            }
+            heap_sift_down(p, 0);
+            continue;
+        }
+
+        if (ev->filter != EVFILT_TIMER) {
+            // timeout of ev:await()
+            heap_remove(p, t);
+            if (!ev->pending) {
+                ev->timedout = 1;
+                poll_pending_add(p, ev);
+                n++;
+            }
+            continue;
+        }
+
+        if (ev->reg_evt.events & EV_ONESHOT) {
+            // oneshot timer will be unwatched when it is consumed
+            heap_remove(p, t);
+        } else {
+            // schedule next expiration without accumulating missed intervals
+            count += (now - t->deadline) / t->interval;
+            t->deadline += t->interval * count;
+            heap_sift_down(p, 0);
+        }
+
+        if (!ev->pending) {
+            poll_pending_add(p, ev);
+            n++;
+        }
+        // accumulate the number of expirations until it is consumed
+        ev->occ_data += count;
+    }
+
+    if (timer_arm(p) != POLL_OK) {
+        return POLL_ERROR;
+    }
+    return n;
+}
+
+int poll_timer_renew(poll_t *p)
+{
+    // NOTE: the timerfd is shared with the parent process after fork, so
+    // create a new one for the new epoll descriptor.
+    if (p->timerfd != -1) {
+        close(p->timerfd);
+        p->timerfd          = -1;
+        p->timerfd_deadline = 0;
+    }
+    return timer_arm(p);
+}
+
+void poll_timer_free(poll_t *p)
+{
+    if (p->timerfd != -1) {
+        close(p->timerfd);
+        p->timerfd = -1;
+    }
+    free(p->timers);
+    p->timers    = NULL;
+    p->ntimer    = 0;
+    p->timersize = 0;
+}
+
 int poll_timer_new(lua_State *L)
 {
     poll_event_t *ev = luaL_checkudata(L, 1, POLL_EVENT_MT);
@@ -131,7 +460,7 @@ int poll_timer_new(lua_State *L)
         return 3;
     }
 
-    if (poll_evset_getflag(L, ev->p->ref_evset_timer, ident)) {
+    if (poll_evset_getflag(L, ev->p, EVFILT_TIMER, ident)) {
         // already registered
         errno = EEXIST;
         lua_pushnil(L);
@@ -140,39 +469,16 @@ int poll_timer_new(lua_State *L)
         return 3;
     }
 
-    struct itimerspec its = {0};
-    if (sec) {
-        // convert sec to interval-timespec
-        its.it_interval.tv_sec = sec;
-        its.it_interval.tv_nsec =
-            (sec - (lua_Number)its.it_interval.tv_sec) * 1000000000;
-        // set first invocation time
-        its.it_value = its.it_interval;
-    }
-
-    // create timerfd
-    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
-    if (fd == -1) {
-        lua_pushnil(L);
-        lua_pushstring(L, strerror(errno));
-        lua_pushinteger(L, errno);
-        return 3;
-    }
-    // set interval and first invocation time
-    if (timerfd_settime(fd, 0, &its, NULL) == -1) {
-        close(fd);
-        lua_pushnil(L);
-        lua_pushstring(L, strerror(errno));
-        lua_pushinteger(L, errno);
-        return 3;
-    }
-
     ev->ident  = ident;
     ev->filter = EVFILT_TIMER;
     ev->reg_evt.events |= EPOLLIN;
-    ev->reg_evt.data.fd = fd;
+    // NOTE: timer event does not have its own descriptor
+    ev->reg_evt.data.fd = -1;
+    // convert sec to interval nanoseconds
+    ev->timer.interval  = (sec >= (lua_Number)(UINT32_MAX)) ?
+                              (uint64_t)UINT32_MAX * 1000000000 :
+                              (uint64_t)(sec * 1000000000);
     if (poll_watch_event(L, ev, 1) != POLL_OK) {
-        close(fd);
         lua_pushnil(L);
         lua_pushstring(L, strerror(errno));
         lua_pushinteger(L, errno);
@@ -213,6 +519,11 @@ void libopen_poll_timer(lua_State *L)
         {"ident",      ident_lua     },
         {"udata",      udata_lua     },
         {"getinfo",    getinfo_lua   },
+        {"events",     events_lua    },
+        {"revents",    revents_lua   },
+        {"await",      await_lua     },
+        {"on",         on_lua        },
+        {"priority",   priority_lua  },
         {NULL,         NULL          }
     };
 
@@ -21,6 +21,7 @@
  */
 
 #include "lua_epoll.h"
+#include <stdlib.h>
 #include <sys/eventfd.h>
 
 #define MODULE_MT POLL_TRIGGER_MT
@@ -36,21 +37,39 @@ int poll_trigger_new(lua_State *L)
         ev->ref_udata = getrefat(L, 3);
     }
 
+    poll_trigger_t *trigger = malloc(sizeof(poll_trigger_t));
+    if (!trigger) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        lua_pushinteger(L, errno);
+        return 3;
+    }
     int efd = eventfd(0, flags);
     if (efd == -1) {
+        int err = errno;
+        free(trigger);
+        errno = err;
         lua_pushnil(L);
         lua_pushstring(L, strerror(errno));
         lua_pushinteger(L, errno);
         return 3;
     }
+    *trigger = (poll_trigger_t){
+        .fd        = efd,
+        .semaphore = semaphore,
+        .pending   = 0,
+        .nref      = 1,
+    };
 
     ev->ident           = efd;
     ev->filter          = EVFILT_TRIGGER;
+    ev->trigger         = trigger;
     ev->reg_evt.events  = EPOLLIN;
     ev->reg_evt.data.fd = efd;
     if (poll_watch_event(L, ev, 1) != POLL_OK) {
         int err = errno;
-        close(efd);
+        poll_trigger_release(trigger);
+        ev->trigger         = NULL;
         ev->ident           = 0;
         ev->filter          = 0;
         ev->reg_evt.events  = 0;
@@ -95,11 +114,46 @@ static int trigger_lua(lua_State *L)
     return 1;
 }
 
+static int handle_lua(lua_State *L)
+{
+    poll_event_t *ev = luaL_checkudata(L, 1, MODULE_MT);
+
+    // NOTE: the handle is valid while the event is alive. the native code
+    // should retain it by poll_trigger_retain() to use it after that.
+    lua_pushlightuserdata(L, ev->trigger);
+    return 1;
+}
+
 static int getinfo_lua(lua_State *L)
 {
     return poll_event_getinfo_lua(L, MODULE_MT);
 }
 
+static int events_lua(lua_State *L)
+{
+    return poll_event_events_lua(L, MODULE_MT);
+}
+
+static int revents_lua(lua_State *L)
+{
+    return poll_event_revents_lua(L, MODULE_MT);
+}
+
+static int await_lua(lua_State *L)
+{
+    return poll_event_await_lua(L, MODULE_MT);
+}
+
+static int on_lua(lua_State *L)
+{
+    return poll_event_on_lua(L, MODULE_MT);
+}
+
+static int priority_lua(lua_State *L)
+{
+    return poll_event_priority_lua(L, MODULE_MT);
+}
+
 static int udata_lua(lua_State *L)
 {
     return poll_event_udata_lua(L, MODULE_MT);
@@ -198,8 +252,10 @@ void libopen_poll_trigger(lua_State *L)
         {"renew",      renew_lua     },
         {"revert",     revert_lua    },
         {"watch",      watch_lua     },
+        {"rearm",      watch_lua     },
         {"unwatch",    unwatch_lua   },
         {"trigger",    trigger_lua   },
+        {"handle",     handle_lua    },
         {"is_enabled", is_enabled_lua},
         {"is_eof",     is_eof_lua    },
         {"is_level",   is_level_lua  },
@@ -211,6 +267,11 @@ void libopen_poll_trigger(lua_State *L)
         {"ident",      ident_lua     },
         {"udata",      udata_lua     },
         {"getinfo",    getinfo_lua   },
+        {"events",     events_lua    },
+        {"revents",    revents_lua   },
+        {"await",      await_lua     },
+        {"on",         on_lua        },
+        {"priority",   priority_lua  },
         {NULL,         NULL          }
     };
 
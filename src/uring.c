@@ -0,0 +1,369 @@
+/**
+ *  Copyright (C) 2023 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#include "lua_epoll.h"
+#include <stdlib.h>
+
+#if HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+// NOTE: IORING_OP_EPOLL_CTL is available since linux 5.6 that introduces
+// IORING_SETUP_CLAMP.
+# if defined(IORING_SETUP_CLAMP) && defined(__NR_io_uring_setup)
+#  define USE_IO_URING 1
+# endif
+#endif
+
+#if USE_IO_URING
+
+# define URING_ENTRIES 64
+// the interruption of a wait within this period after the io_uring instance
+// is released is regarded as the one caused by the release
+# define URING_INTR_WINDOW ((uint64_t)100000000)
+
+struct poll_uring {
+    int fd;
+    // submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    // completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    // mapped memory
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    uint32_t gen; // generation of the batch
+};
+
+static inline int uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static inline int uring_register(int fd, unsigned opcode, void *arg,
+                                 unsigned nargs)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+}
+
+static void uring_unmap(poll_uring_t *u)
+{
+    if (u->sqes) {
+        munmap(u->sqes, u->sqes_size);
+    }
+    if (u->cq_ring && u->cq_ring != u->sq_ring) {
+        munmap(u->cq_ring, u->cq_ring_size);
+    }
+    if (u->sq_ring) {
+        munmap(u->sq_ring, u->sq_ring_size);
+    }
+}
+
+// check if the running kernel supports IORING_OP_EPOLL_CTL
+static int uring_probe(int fd)
+{
+    size_t len = sizeof(struct io_uring_probe) +
+                 sizeof(struct io_uring_probe_op) * (IORING_OP_EPOLL_CTL + 1);
+    struct io_uring_probe *probe = calloc(1, len);
+    int supported                = 0;
+
+    if (!probe) {
+        return 0;
+    } else if (uring_register(fd, IORING_REGISTER_PROBE, probe,
+                              IORING_OP_EPOLL_CTL + 1) == 0) {
+        supported = probe->last_op >= IORING_OP_EPOLL_CTL &&
+                    (probe->ops[IORING_OP_EPOLL_CTL].flags &
+                     IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
+
+static poll_uring_t *uring_open(void)
+{
+    struct io_uring_params params = {0};
+    poll_uring_t *u               = calloc(1, sizeof(poll_uring_t));
+
+    if (!u) {
+        return NULL;
+    }
+    u->fd = uring_setup(URING_ENTRIES, &params);
+    if (u->fd == -1) {
+        free(u);
+        return NULL;
+    } else if (!uring_probe(u->fd)) {
+        close(u->fd);
+        free(u);
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    // map the submission and completion queue rings
+    u->sq_ring_size =
+        params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    u->cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size) {
+            u->sq_ring_size = u->cq_ring_size;
+        }
+        u->cq_ring_size = u->sq_ring_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) {
+        u->sq_ring = NULL;
+        goto FAILED;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) {
+            u->cq_ring = NULL;
+            goto FAILED;
+        }
+    }
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes      = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        goto FAILED;
+    }
+
+    u->sq_head  = (unsigned *)((char *)u->sq_ring + params.sq_off.head);
+    u->sq_tail  = (unsigned *)((char *)u->sq_ring + params.sq_off.tail);
+    u->sq_mask  = (unsigned *)((char *)u->sq_ring + params.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ring + params.sq_off.array);
+    u->cq_head  = (unsigned *)((char *)u->cq_ring + params.cq_off.head);
+    u->cq_tail  = (unsigned *)((char *)u->cq_ring + params.cq_off.tail);
+    u->cq_mask  = (unsigned *)((char *)u->cq_ring + params.cq_off.ring_mask);
+    u->cqes =
+        (struct io_uring_cqe *)((char *)u->cq_ring + params.cq_off.cqes);
+
+    return u;
+
+FAILED: {
+    int err = errno;
+    uring_unmap(u);
+    close(u->fd);
+    free(u);
+    errno = err;
+    return NULL;
+}
+}
+
+// the time when the io_uring instance was released by this thread
+static __thread uint64_t released_at = 0;
+
+static void uring_close(poll_uring_t *u)
+{
+    uring_unmap(u);
+    close(u->fd);
+    free(u);
+    released_at = poll_gettime();
+}
+
+// fallback to the epoll_ctl for the requests that are not submitted
+static void ctl_fallback(poll_t *p, poll_ctlreq_t *reqs, int n)
+{
+    for (int i = 0; i < n; i++) {
+        poll_ctlreq_t *req = reqs + i;
+        req->res           = 0;
+        if (epoll_ctl(p->fd, req->op, req->fd, req->evt) == -1) {
+            req->res = -errno;
+        }
+    }
+}
+
+// reap all completions in the ring. the completions of the previous batches
+// that have been abandoned are discarded by the generation in the upper 32
+// bits of the user_data. it returns the number of reaped completions of the
+// current batch.
+static unsigned uring_reap(poll_uring_t *u, poll_ctlreq_t *reqs)
+{
+    unsigned head = *u->cq_head;
+    unsigned n    = 0;
+
+    while (head != __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = u->cqes + (head & *u->cq_mask);
+        if ((uint32_t)(cqe->user_data >> 32) == u->gen) {
+            reqs[(uint32_t)cqe->user_data].res = cqe->res;
+            n++;
+        }
+        head++;
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+void poll_uring_ctl_batch(poll_t *p, poll_ctlreq_t *reqs, int n)
+{
+    poll_uring_t *u   = p->uring;
+    unsigned nentries = *u->sq_mask + 1;
+    int i             = 0;
+
+    while (i < n) {
+        unsigned tail  = *u->sq_tail;
+        unsigned nreq  = 0;
+        unsigned nwait = 0;
+        unsigned nsub  = 0;
+        unsigned ndone = 0;
+
+        // prepare the epoll_ctl requests up to the size of the ring
+        u->gen++;
+        for (; i + (int)nreq < n && nreq < nentries; nreq++) {
+            poll_ctlreq_t *req = reqs + i + nreq;
+            unsigned idx       = (tail + nreq) & *u->sq_mask;
+
+            req->res     = -EIO;
+            u->sqes[idx] = (struct io_uring_sqe){
+                .opcode    = IORING_OP_EPOLL_CTL,
+                .fd        = p->fd,
+                .addr      = (uint64_t)(uintptr_t)req->evt,
+                .len       = (uint32_t)req->op,
+                .off       = (uint64_t)req->fd,
+                .user_data = ((uint64_t)u->gen << 32) | (uint32_t)(i + nreq),
+            };
+            u->sq_array[idx] = idx;
+        }
+        __atomic_store_n(u->sq_tail, tail + nreq, __ATOMIC_RELEASE);
+
+        // submit the requests and wait for their completions
+        nwait = nreq;
+        while (ndone < nwait) {
+            int rv = uring_enter(u->fd, nwait - nsub, nwait - ndone,
+                                 IORING_ENTER_GETEVENTS);
+            nsub   = __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) - tail;
+            ndone += uring_reap(u, reqs);
+            if (rv != -1 || errno == EINTR) {
+                continue;
+            } else if (nsub < nwait) {
+                // discard the requests that are not submitted and fallback
+                // to the epoll_ctl
+                __atomic_store_n(u->sq_tail, tail + nsub, __ATOMIC_RELEASE);
+                ctl_fallback(p, reqs + i + nsub, (int)(nwait - nsub));
+                nwait = nsub;
+                continue;
+            }
+            // NOTE: the requests have been submitted but their completions
+            // cannot be waited. the results are left as EIO, and the
+            // completions that arrive later are discarded by the generation.
+            break;
+        }
+        i += (int)nreq;
+    }
+}
+
+int poll_uring_open(poll_t *p)
+{
+    poll_uring_t *u = uring_open();
+
+    if (!u) {
+        return POLL_ERROR;
+    }
+    p->uring = u;
+    return POLL_OK;
+}
+
+void poll_uring_free(poll_t *p)
+{
+    if (p->uring) {
+        uring_close(p->uring);
+        p->uring = NULL;
+    }
+}
+
+int poll_uring_interrupted(void)
+{
+    // NOTE: the kernel tears down the io_uring context of the thread by the
+    // task works that are notified asynchronously after the instance is
+    // released, and they may interrupt the blocking syscalls of the thread
+    // more than once.
+    if (released_at && poll_gettime() - released_at < URING_INTR_WINDOW) {
+        return 1;
+    }
+    released_at = 0;
+    return 0;
+}
+
+#else
+
+void poll_uring_ctl_batch(poll_t *p, poll_ctlreq_t *reqs, int n)
+{
+    for (int i = 0; i < n; i++) {
+        poll_ctlreq_t *req = reqs + i;
+        req->res           = 0;
+        if (epoll_ctl(p->fd, req->op, req->fd, req->evt) == -1) {
+            req->res = -errno;
+        }
+    }
+}
+
+int poll_uring_open(poll_t *p)
+{
+    (void)p;
+    errno = ENOTSUP;
+    return POLL_ERROR;
+}
+
+void poll_uring_free(poll_t *p)
+{
+    (void)p;
+}
+
+int poll_uring_interrupted(void)
+{
+    return 0;
+}
+
+#endif
+
+int poll_uring_renew(poll_t *p)
+{
+    // NOTE: the memory of the ring is shared with the parent process after
+    // fork, so create a new ring for the new epoll descriptor. if it fails,
+    // fallback to the epoll_ctl.
+    if (p->uring) {
+        poll_uring_free(p);
+        poll_uring_open(p);
+    }
+    return POLL_OK;
+}
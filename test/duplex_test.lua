@@ -0,0 +1,156 @@
+local testcase = require('testcase')
+local socketpair = require('testcase.socketpair')
+local epoll = require('epoll')
+local errno = require('errno')
+
+if not epoll.usable() then
+    return
+end
+
+local Reader
+local Writer
+
+function testcase.before_each()
+    for _, sock in pairs({
+        Reader,
+        Writer,
+    }) do
+        if sock then
+            sock:close()
+        end
+    end
+
+    Reader, Writer = assert(socketpair())
+end
+
+function testcase.type()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_duplex(Reader:fd()))
+
+    -- test that get the event type
+    assert.equal(ev:type(), 'duplex')
+    assert.match(ev, '^epoll%.duplex: ', false)
+end
+
+function testcase.renew()
+    local ep1 = assert(epoll.new())
+    local ep2 = assert(epoll.new())
+    local ev = ep1:new_event()
+    assert(ev:as_duplex(Reader:fd()))
+
+    -- test that renew event with other epoll
+    assert(ev:renew(ep2))
+end
+
+function testcase.as_duplex_conflict()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+
+    -- test that return error if fd is already watched by read event
+    local ev2 = ep:new_event()
+    local _, err, errnum = ev2:as_duplex(Reader:fd())
+    assert.is_nil(_)
+    assert.equal(err, errno.EEXIST.message)
+    assert.equal(errnum, errno.EEXIST.code)
+
+    -- test that read/write event cannot be registered on the duplex fd
+    assert(ev:revert())
+    assert(ev2:as_duplex(Reader:fd()))
+    _, err, errnum = ep:new_event():as_write(Reader:fd())
+    assert.is_nil(_)
+    assert.equal(err, errno.EEXIST.message)
+    assert.equal(errnum, errno.EEXIST.code)
+end
+
+function testcase.want_read_want_write()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_duplex(Reader:fd(), 'ctx'))
+    assert.equal(#ep, 1)
+
+    -- test that both directions are reported in a single event
+    assert(Writer:write('test'))
+    local nevt = assert(ep:wait(0.1))
+    assert.equal(nevt, 1)
+    local oev, udata = assert(ep:consume())
+    assert.equal(oev, ev)
+    assert.equal(udata, 'ctx')
+    assert.is_true(oev:is_readable())
+    assert.is_true(oev:is_writable())
+
+    -- test that disable the write interest without unwatching the event
+    assert.is_true(ev:want_write(false))
+    assert.is_true(ev:is_enabled())
+    nevt = assert(ep:wait(0.1))
+    assert.equal(nevt, 1)
+    oev = assert(ep:consume())
+    assert.is_true(oev:is_readable())
+    assert.is_false(oev:is_writable())
+
+    -- test that disable the read interest
+    assert.is_true(ev:want_read(false))
+    nevt = assert(ep:wait(0.01))
+    assert.equal(nevt, 0)
+
+    -- test that enable the write interest again
+    assert.is_true(ev:want_write(true))
+    nevt = assert(ep:wait(0.1))
+    assert.equal(nevt, 1)
+    oev = assert(ep:consume())
+    assert.is_false(oev:is_readable())
+    assert.is_true(oev:is_writable())
+
+    -- test that throws an error if argument is not boolean
+    local err = assert.throws(function()
+        ev:want_read()
+    end)
+    assert.match(err, 'boolean expected')
+end
+
+function testcase.want_read_want_write_with_trigger()
+    local ep = assert(epoll.new())
+
+    for _, trigger in ipairs({
+        'as_edge',
+        'as_level',
+    }) do
+        local ev = ep:new_event()
+        assert(ev[trigger](ev))
+        assert(ev:as_duplex(Reader:fd()))
+
+        -- test that the interest can be changed after the trigger is changed
+        assert.is_true(ev:want_write(false))
+        assert.is_true(ev:want_read(false))
+        assert.is_true(ev:want_write(true))
+        assert.equal(assert(ep:wait(0.1)), 1)
+        local oev = assert(ep:consume())
+        assert.is_false(oev:is_readable())
+        assert.is_true(oev:is_writable())
+        assert(ev:unwatch())
+
+        -- test that the trigger can be changed on the unwatched event
+        assert(ev[trigger](ev))
+        assert(ev:watch())
+        assert.is_true(ev:want_read(true))
+        assert(ev:unwatch())
+    end
+end
+
+function testcase.want_read_unwatched()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_duplex(Reader:fd()))
+    assert(ev:unwatch())
+
+    -- test that the interest is applied when the event is watched
+    assert.is_true(ev:want_write(false))
+    assert(Writer:write('test'))
+    assert(ev:watch())
+    local nevt = assert(ep:wait(0.1))
+    assert.equal(nevt, 1)
+    local oev = assert(ep:consume())
+    assert.is_true(oev:is_readable())
+    assert.is_false(oev:is_writable())
+end
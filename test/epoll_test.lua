@@ -1,6 +1,10 @@
 local testcase = require('testcase')
 local socketpair = require('testcase.socketpair')
+local getpid = require('testcase.getpid')
+local sleep = require('testcase.timer').sleep
 local epoll = require('epoll')
+local errno = require('errno')
+local signal = require('signal')
 
 if not epoll.usable() then
     function testcase.usable()
@@ -42,6 +46,574 @@ function testcase.new()
     -- test that create a new epoll
     local ep = assert(epoll.new())
     assert.match(ep, '^epoll: ', false)
+    assert.equal(ep:backend(), 'epoll')
+
+    -- test that create a new epoll with io_uring backend
+    ep = assert(epoll.new({
+        backend = 'io_uring',
+    }))
+    local backend = ep:backend()
+    assert(backend == 'epoll' or backend == 'io_uring')
+
+    -- test that throws an error if backend is invalid
+    local err = assert.throws(epoll.new, {
+        backend = 'kqueue',
+    })
+    assert.match(err, "backend must be 'epoll' or 'io_uring'")
+end
+
+function testcase.new_with_capacity_and_maxevents()
+    -- test that create a new epoll with preallocated event list
+    local ep = assert(epoll.new({
+        capacity = 4096,
+    }))
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+
+    -- test that the number of events of each wait is capped by maxevents
+    ep = assert(epoll.new({
+        maxevents = 2,
+    }))
+    local evs = {}
+    for i = 1, 3 do
+        evs[i] = ep:new_event()
+    end
+    assert(evs[1]:as_read(Reader:fd()))
+    assert(evs[2]:as_write(Writer:fd()))
+    assert(evs[3]:as_write(Reader:fd()))
+    assert.equal(assert(ep:wait(0.1)), 2)
+    assert.equal(assert(ep:wait(0.1)), 2)
+
+    -- test that throws an error if options are invalid
+    for _, opts in ipairs({
+        {
+            capacity = 0,
+        },
+        {
+            maxevents = -1,
+        },
+        {
+            maxevents = 'foo',
+        },
+    }) do
+        local err = assert.throws(epoll.new, opts)
+        assert.match(err, 'must be positive integer')
+    end
+end
+
+function testcase.set_busy_poll_get_busy_poll()
+    local ep = assert(epoll.new())
+
+    -- test that set busy poll parameters or return ENOTSUP on older kernels
+    local ok, err, errnum = ep:set_busy_poll({
+        usecs = 50,
+        budget = 8,
+        prefer = true,
+    })
+    if not ok then
+        assert.equal(err, errno.ENOTSUP.message)
+        assert.equal(errnum, errno.ENOTSUP.code)
+        return
+    end
+    assert.is_true(ok)
+
+    -- test that get busy poll parameters
+    local params = assert(ep:get_busy_poll())
+    assert.is_int(params.usecs)
+    assert.is_int(params.budget)
+    assert.is_boolean(params.prefer)
+
+    -- test that parameters are applied again after renew
+    assert(ep:renew())
+    assert(ep:get_busy_poll())
+
+    -- test that throws an error if parameters are out of range
+    err = assert.throws(ep.set_busy_poll, ep, {
+        usecs = -1,
+    })
+    assert.match(err, 'usecs must be in range')
+    err = assert.throws(ep.set_busy_poll, ep, {
+        budget = 0x10000,
+    })
+    assert.match(err, 'budget must be in range')
+end
+
+function testcase.stats()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+
+    -- test that all counters are zero
+    local stats = ep:stats()
+    assert.equal(stats.wait, 0)
+    assert.equal(stats.wait_time, 0)
+    assert.equal(stats.events, 0)
+    assert.equal(#stats.histogram, 16)
+    for _, v in ipairs(stats.histogram) do
+        assert.equal(v, 0)
+    end
+
+    -- test that count the epoll_ctl calls, waits and events
+    assert(ev:as_read(Reader:fd()))
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+
+    -- test that count the events skipped since they were unwatched
+    assert(ev:unwatch())
+    assert.is_nil(ep:consume())
+    stats = ep:stats(true)
+    assert.equal(stats.wait, 1)
+    assert.is_number(stats.wait_time)
+    assert.equal(stats.events, 1)
+    assert.equal(stats.histogram[1], 0)
+    assert.equal(stats.histogram[2], 1)
+    assert.equal(stats.skipped, 1)
+    assert.equal(stats.interrupted, 0)
+    assert.equal(stats.ctl_add, 1)
+    assert.equal(stats.ctl_mod, 0)
+    assert.equal(stats.ctl_del, 1)
+    assert.equal(stats.drain_read, 0)
+
+    -- test that counters are reset
+    stats = ep:stats()
+    assert.equal(stats.wait, 0)
+    assert.equal(stats.events, 0)
+    assert.equal(stats.skipped, 0)
+    assert.equal(stats.ctl_add, 0)
+    assert.equal(stats.ctl_del, 0)
+
+    -- test that count the drain reads of the trigger event
+    assert(ev:revert())
+    assert(ev:as_trigger())
+    assert(ev:trigger())
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), ev)
+    assert.equal(ep:stats().drain_read, 1)
+end
+
+function testcase.changelist()
+    local ep = assert(epoll.new({
+        changelist = true,
+    }))
+    local ev = ep:new_event()
+
+    -- test that the registration changes are deferred until wait
+    assert(ev:as_read(Reader:fd(), 'ctx'))
+    assert(ev:unwatch())
+    assert(ev:watch())
+    local stats = ep:stats()
+    assert.equal(stats.ctl_add, 0)
+    assert.equal(stats.ctl_del, 0)
+
+    -- test that apply the net changes before waiting
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), ev)
+    stats = ep:stats(true)
+    assert.equal(stats.ctl_add, 1)
+    assert.equal(stats.ctl_del, 0)
+    assert.equal(stats.ctl_cancelled, 2)
+    Reader:read()
+
+    -- test that the registration is deleted immediately by unwatch
+    assert(ev:unwatch())
+    assert.equal(ep:stats().ctl_del, 1)
+
+    -- test that the add and modify requests are merged
+    ev = assert(ep:new_event():as_duplex(Reader:fd()))
+    assert(ev:want_write(false))
+    assert.equal(assert(ep:wait(0.01)), 0)
+    stats = ep:stats(true)
+    assert.equal(stats.ctl_add, 1)
+    assert.equal(stats.ctl_mod, 0)
+    assert.equal(stats.ctl_del, 1)
+    assert.equal(stats.ctl_cancelled, 1)
+
+    -- test that the changes that cancel each other do not call epoll_ctl
+    assert(ev:want_write(true))
+    assert(ev:want_write(false))
+    assert.equal(assert(ep:wait(0.01)), 0)
+    stats = ep:stats(true)
+    assert.equal(stats.ctl_mod, 0)
+    assert.equal(stats.ctl_cancelled, 2)
+
+    -- test that deliver the error of the deferred registration as event
+    local sock1, sock2 = assert(socketpair())
+    local fd = sock1:fd()
+    sock1:close()
+    sock2:close()
+    local ev2 = ep:new_event()
+    assert(ev2:as_read(fd, 'bad'))
+    assert.equal(assert(ep:wait(1)), 1)
+    local oev, udata, disabled, eof, err, errnum = ep:consume()
+    assert.equal(oev, ev2)
+    assert.equal(udata, 'bad')
+    assert.is_true(disabled)
+    assert.is_true(eof)
+    assert.equal(err, errno.EBADF.message)
+    assert.equal(errnum, errno.EBADF.code)
+    assert.is_false(ev2:is_enabled())
+end
+
+function testcase.exclusive()
+    local function is_exclusive(ev)
+        local bit = epoll.EPOLLEXCLUSIVE
+        return ev:events() % (bit * 2) >= bit
+    end
+    local ep = assert(epoll.new())
+    local ep1 = assert(epoll.new({
+        exclusive = true,
+    }))
+    local ep2 = assert(epoll.new({
+        exclusive = true,
+    }))
+
+    -- test that the read event is not registered exclusively by default
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+    assert.is_false(is_exclusive(ev))
+    assert(ev:unwatch())
+
+    -- test that the read events are registered exclusively
+    local ev1 = ep1:new_event()
+    assert(ev1:as_read(Reader:fd()))
+    assert.is_true(is_exclusive(ev1))
+    assert.is_true(ev1:is_level())
+    local ev2 = ep2:new_event()
+    assert(ev2:as_read(Reader:fd()))
+    assert.is_true(is_exclusive(ev2))
+    assert(Writer:write('test'))
+    assert.equal(assert(ep1:wait(0.1)), 1)
+    assert.equal(ep1:consume(), ev1)
+    assert.equal(assert(ep2:wait(0.1)), 1)
+    assert.equal(ep2:consume(), ev2)
+    assert(ev1:unwatch())
+    assert(ev2:unwatch())
+
+    -- test that the read events created by ep:watch_many() are registered
+    -- exclusively, but the write events are not
+    local evs = assert(ep1:watch_many({
+        Reader:fd(),
+    }, 'read'))
+    assert.is_true(is_exclusive(evs[1]))
+    assert.is_true(ep1:unwatch_many(evs))
+    evs = assert(ep1:watch_many({
+        Writer:fd(),
+    }, 'write'))
+    assert.is_false(is_exclusive(evs[1]))
+    assert.is_true(ep1:unwatch_many(evs))
+
+    -- test that oneshot events are not registered exclusively
+    ev1 = ep1:new_event()
+    assert(ev1:as_oneshot())
+    assert(ev1:as_read(Reader:fd()))
+    assert.is_false(is_exclusive(ev1))
+    assert.equal(assert(ep1:wait(0.1)), 1)
+    assert.equal(ep1:consume(), ev1)
+    Reader:read()
+end
+
+function testcase.await_run()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+
+    -- test that throws an error if await outside a coroutine
+    local err = assert.throws(ev.await, ev)
+    assert.match(err, 'attempt to await outside a coroutine')
+
+    -- test that resume the coroutine when the event occurs
+    local res = {}
+    local co = coroutine.create(function()
+        res[#res + 1] = {
+            ev:await(),
+        }
+        Reader:read()
+        res[#res + 1] = {
+            ev:await(0.01),
+        }
+    end)
+    assert(coroutine.resume(co))
+    assert.equal(coroutine.status(co), 'suspended')
+    assert(Writer:write('test'))
+    assert.is_true(ep:run())
+    assert.equal(coroutine.status(co), 'dead')
+    assert.equal(res[1], {
+        true,
+    })
+
+    -- test that resume the coroutine with timeout
+    assert.equal(res[2], {
+        false,
+        errno.ETIMEDOUT.message,
+        errno.ETIMEDOUT.code,
+        true,
+    })
+
+    -- test that return true immediately if no coroutines await
+    assert.is_true(ep:run())
+
+    -- test that propagate the error of the coroutine
+    co = coroutine.create(function()
+        ev:await()
+        error('test error')
+    end)
+    assert(coroutine.resume(co))
+    assert(Writer:write('test'))
+    err = assert.throws(ep.run, ep)
+    assert.match(err, 'test error')
+end
+
+function testcase.await_resumed_by_others()
+    local ep = assert(epoll.new())
+    local ev1 = ep:new_event()
+    assert(ev1:as_read(Reader:fd()))
+    local ev2 = ep:new_event()
+    assert(ev2:as_read(Writer:fd()))
+
+    -- test that the coroutine yielded elsewhere is not resumed by the event
+    local res = {}
+    local co = coroutine.create(function()
+        res[#res + 1] = {
+            ev1:await(),
+        }
+        res[#res + 1] = {
+            coroutine.yield('elsewhere'),
+        }
+    end)
+    assert(coroutine.resume(co))
+    assert(coroutine.resume(co, 'by others'))
+    assert(Writer:write('test'))
+    assert.is_true(ep:run())
+    assert.equal(coroutine.status(co), 'suspended')
+    assert(coroutine.resume(co, 'again'))
+    assert.equal(res, {
+        {
+            'by others',
+        },
+        {
+            'again',
+        },
+    })
+    Reader:read()
+
+    -- test that the coroutine awaiting another event is not resumed with the
+    -- results of the event
+    res = {}
+    co = coroutine.create(function()
+        ev1:await()
+        res[#res + 1] = {
+            ev2:await(0.05),
+        }
+    end)
+    assert(coroutine.resume(co))
+    assert(coroutine.resume(co))
+    assert(Writer:write('test'))
+    assert.is_true(ep:run())
+    assert.equal(coroutine.status(co), 'dead')
+    assert.equal(res, {
+        {
+            false,
+            errno.ETIMEDOUT.message,
+            errno.ETIMEDOUT.code,
+            true,
+        },
+    })
+
+    -- test that the coroutine can await the same event again after it was
+    -- resumed by others
+    res = {}
+    co = coroutine.create(function()
+        ev1:await()
+        res[#res + 1] = {
+            ev1:await(),
+        }
+    end)
+    assert(coroutine.resume(co))
+    assert(coroutine.resume(co))
+    assert.equal(coroutine.status(co), 'suspended')
+    assert.is_true(ep:run())
+    assert.equal(coroutine.status(co), 'dead')
+    assert.equal(res, {
+        {
+            true,
+        },
+    })
+end
+
+function testcase.on_run_stop()
+    local ep = assert(epoll.new())
+    local rev = ep:new_event()
+    assert(rev:as_read(Reader:fd(), 'reader'))
+    local wev = ep:new_event()
+    assert(wev:as_write(Writer:fd(), 'writer'))
+
+    -- test that the handler is called with the dispatch arguments
+    local calls = {}
+    assert.equal(wev:on(function(ev, udata)
+        calls[#calls + 1] = {
+            ev,
+            udata,
+        }
+        ep:stop()
+    end), wev)
+    assert.is_true(ep:run(1))
+    assert.equal(calls, {
+        {
+            wev,
+            'writer',
+        },
+    })
+
+    -- test that run_once returns the number of the dispatched events
+    calls = {}
+    assert(wev:on(function(_, udata)
+        calls[#calls + 1] = udata
+    end))
+    assert(rev:on(function(ev, udata)
+        calls[#calls + 1] = udata
+        Reader:read()
+        ev:on()
+    end))
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:run_once(1)), 2)
+    table.sort(calls)
+    assert.equal(calls, {
+        'reader',
+        'writer',
+    })
+
+    -- test that run returns immediately if no handlers are set
+    assert(wev:on())
+    assert.is_true(ep:run())
+
+    -- test that throws an error if the handler is not a function
+    local err = assert.throws(wev.on, wev, 'foo')
+    assert.match(err, 'function expected')
+
+    -- test that propagate the error of the handler
+    assert(wev:on(function()
+        error('test error')
+    end))
+    err = assert.throws(ep.run, ep)
+    assert.match(err, 'test error')
+end
+
+function testcase.run_unhandled_event()
+    local ep = assert(epoll.new())
+    local rev = ep:new_event()
+    assert(rev:as_read(Reader:fd()))
+    local wev = ep:new_event()
+    assert(wev:as_write(Writer:fd()))
+    local ncall = 0
+    assert(wev:on(function()
+        ncall = ncall + 1
+        if ncall == 2 then
+            ep:stop()
+        end
+    end))
+
+    -- test that the event that has no coroutine and handler is disarmed
+    -- without removing its registration
+    assert(Writer:write('test'))
+    ep:stats(true)
+    assert.is_true(ep:run(1))
+    assert.equal(ncall, 2)
+    assert.is_false(rev:is_enabled())
+    local stats = ep:stats(true)
+    assert.equal(stats.ctl_mod, 1)
+    assert.equal(stats.ctl_del, 0)
+    assert(wev:unwatch())
+    assert.equal(assert(ep:wait(0)), 0)
+
+    -- test that the disarmed event is re-armed by ev:watch()
+    ep:stats(true)
+    assert(rev:watch())
+    assert.is_true(rev:is_enabled())
+    stats = ep:stats(true)
+    assert.equal(stats.ctl_mod, 1)
+    assert.equal(stats.ctl_add, 0)
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), rev)
+
+    -- test that the disarmed event is re-armed by ev:await()
+    assert(Writer:write('test'))
+    assert.is_true(ep:run())
+    assert.is_false(rev:is_enabled())
+    local co = coroutine.create(function()
+        return rev:await()
+    end)
+    assert(coroutine.resume(co))
+    assert.is_true(rev:is_enabled())
+    assert.is_true(ep:run())
+    assert.equal(coroutine.status(co), 'dead')
+end
+
+function testcase.io_uring_backend()
+    local ep = assert(epoll.new({
+        backend = 'io_uring',
+    }))
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd(), 'ctx'))
+
+    -- test that registration changes are applied through the backend
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    local oev, udata = assert(ep:consume())
+    assert.equal(oev, ev)
+    assert.equal(udata, 'ctx')
+    Reader:read()
+
+    -- test that errors of the registration changes are reported
+    local ev2 = ep:new_event()
+    local _, err, errnum = ev2:as_read(-1)
+    assert.is_nil(_)
+    assert.equal(err, errno.EBADF.message)
+    assert.equal(errnum, errno.EBADF.code)
+
+    -- test that unwatch the event
+    assert(ev:unwatch())
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.01)), 0)
+
+    -- test that renew the io_uring backend
+    assert(ep:renew())
+    assert(ev:watch())
+    assert.equal(assert(ep:wait(0.1)), 1)
+    Reader:read()
+    assert(ev:unwatch())
+
+    -- test that the results of the batched requests are not mixed up
+    for _ = 1, 3 do
+        local res, errnum, idx
+        res, _, errnum, idx = ep:watch_many({
+            Reader:fd(),
+            Writer:fd(),
+            -1,
+        }, 'write')
+        assert.is_nil(res)
+        assert.equal(errnum, errno.EBADF.code)
+        assert.equal(idx, 3)
+        assert.equal(#ep, 0)
+    end
+    local evs = assert(ep:watch_many({
+        Reader:fd(),
+        Writer:fd(),
+    }, 'write'))
+    assert.equal(#ep, 2)
+    assert.equal(assert(ep:wait(0.1)), 2)
+    assert.is_true(ep:unwatch_many(evs))
+    assert.equal(#ep, 0)
+
+    -- test that the wait is not interrupted by releasing the io_uring
+    local ep2 = assert(epoll.new())
+    assert(ep2:new_event():as_read(Reader:fd()))
+    assert(ep:renew())
+    local t = epoll.clock()
+    assert.equal(assert(ep2:wait(0.05)), 0)
+    assert.greater_or_equal(epoll.clock() - t, 0.045)
+    assert.equal(ep2:stats().interrupted, 0)
 end
 
 function testcase.renew()
@@ -68,6 +640,79 @@ function testcase.new_event()
     assert.match(ev, '^epoll%.event: ', false)
 end
 
+function testcase.watch_many_unwatch_many()
+    local ep = assert(epoll.new())
+
+    -- test that watch the fds at once
+    local evs = assert(ep:watch_many({
+        Reader:fd(),
+        Writer:fd(),
+    }, 'read', 'edge'))
+    assert.equal(#evs, 2)
+    assert.equal(#ep, 2)
+    for i, fd in ipairs({
+        Reader:fd(),
+        Writer:fd(),
+    }) do
+        assert.equal(evs[i]:type(), 'read')
+        assert.equal(evs[i]:ident(), fd)
+        assert.is_true(evs[i]:is_edge())
+        assert.is_true(evs[i]:is_enabled())
+    end
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), evs[1])
+    Reader:read()
+
+    -- test that revert all the events if any of the fds cannot be watched
+    local res, err, errnum, idx = ep:watch_many({
+        Writer:fd(),
+    }, 'read')
+    assert.is_nil(res)
+    assert.equal(err, errno.EEXIST.message)
+    assert.equal(errnum, errno.EEXIST.code)
+    assert.equal(idx, 1)
+    res, err, errnum, idx = ep:watch_many({
+        Reader:fd(),
+        -1,
+    }, 'write')
+    assert.is_nil(res)
+    assert.equal(errnum, errno.EBADF.code)
+    assert.equal(idx, 2)
+    assert.equal(#ep, 2)
+
+    -- test that the duplicated fd of the reverted event is not closed twice
+    local r, w = assert(socketpair())
+    collectgarbage('collect')
+    collectgarbage('collect')
+    assert(w:write('test'))
+    assert.equal(r:read(), 'test')
+    r:close()
+    w:close()
+
+    -- test that unwatch the events at once
+    assert.is_true(ep:unwatch_many(evs))
+    assert.equal(#ep, 0)
+    assert.is_false(evs[1]:is_enabled())
+    assert.is_false(evs[2]:is_enabled())
+
+    -- test that recycle the unwatched events
+    local recycled = assert(ep:watch_many(evs, 'read'))
+    assert.equal(recycled, evs)
+    assert.equal(#ep, 2)
+    assert.is_true(ep:unwatch_many(evs))
+
+    -- test that throws an error if the list contains invalid value
+    err = assert.throws(ep.watch_many, ep, {
+        'foo',
+    }, 'read')
+    assert.match(err, '#1 must be fd or epoll.read')
+    err = assert.throws(ep.unwatch_many, ep, {
+        {},
+    })
+    assert.match(err, '#1 is not an event of this instance')
+end
+
 function testcase.len()
     local ep = assert(epoll.new())
     local ev = ep:new_event()
@@ -108,6 +753,103 @@ function testcase.wait()
     assert.equal(nevt, 1)
 end
 
+function testcase.clock()
+    -- test that return monotonic time in seconds
+    local t1 = epoll.clock()
+    assert.is_number(t1)
+    local t2 = epoll.clock()
+    assert.greater_or_equal(t2, t1)
+end
+
+function testcase.wait_until()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+
+    -- test that return 0 if the deadline is reached
+    local t = epoll.clock()
+    local nevt = assert(ep:wait_until(t + 0.01))
+    local elapsed = epoll.clock() - t
+    assert.equal(nevt, 0)
+    assert.greater_or_equal(elapsed, 0.009)
+    assert.less(elapsed, 0.1)
+
+    -- test that sub-millisecond timeout is not rounded down to zero
+    t = epoll.clock()
+    nevt = assert(ep:wait(0.0005))
+    elapsed = epoll.clock() - t
+    assert.equal(nevt, 0)
+    assert.greater_or_equal(elapsed, 0.0004)
+    assert.less(elapsed, 0.1)
+
+    -- test that do not block if the deadline has already passed
+    nevt = assert(ep:wait_until(epoll.clock() - 1))
+    assert.equal(nevt, 0)
+
+    -- test that return 1 before the deadline
+    assert(Writer:write('test'))
+    nevt = assert(ep:wait_until(epoll.clock() + 1))
+    assert.equal(nevt, 1)
+
+    -- test that throws an error if deadline is not a number
+    local err = assert.throws(function()
+        ep:wait_until()
+    end)
+    assert.match(err, 'number expected')
+end
+
+function testcase.wait_with_sigmask()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+
+    -- make SIGWINCH pending while it is blocked
+    assert(signal.block(signal.SIGWINCH))
+    assert(signal.kill(signal.SIGWINCH, getpid()))
+
+    -- test that the signal is unblocked only while waiting
+    -- NOTE: the default action of SIGWINCH is to ignore the signal
+    local nevt = assert(ep:wait(0.01, {
+        signal.SIGWINCH,
+    }))
+    assert.equal(nevt, 0)
+    assert.is_true(signal.isblock(signal.SIGWINCH))
+
+    -- test that the pending signal has been discarded while waiting
+    local sev = ep:new_event()
+    assert(sev:as_signal(signal.SIGWINCH))
+    nevt = assert(ep:wait(0.01))
+    assert.equal(nevt, 0)
+
+    -- test that the signal is delivered to signalfd if it is not unblocked
+    assert(signal.kill(signal.SIGWINCH, getpid()))
+    nevt = assert(ep:wait_until(epoll.clock() + 0.1, {}))
+    assert.equal(nevt, 1)
+    assert.equal(ep:consume(), sev)
+    assert(signal.unblock(signal.SIGWINCH))
+
+    -- test that return error if signal number is invalid
+    local err, errnum
+    nevt, err, errnum = ep:wait(0, {
+        0,
+    })
+    assert.is_nil(nevt)
+    assert.equal(err, errno.EINVAL.message)
+    assert.equal(errnum, errno.EINVAL.code)
+
+    -- test that throws an error if sigmask is not a table of signal numbers
+    err = assert.throws(function()
+        ep:wait(0, 'SIGWINCH')
+    end)
+    assert.match(err, 'table expected')
+    err = assert.throws(function()
+        ep:wait(0, {
+            'SIGWINCH',
+        })
+    end)
+    assert.match(err, 'signal numbers expected')
+end
+
 function testcase.unconsumed_events_will_be_consumed_in_wait()
     local ep = assert(epoll.new())
     local ev1 = ep:new_event()
@@ -132,6 +874,193 @@ function testcase.unconsumed_events_will_be_consumed_in_wait()
     assert.is_false(ev2:is_enabled())
 end
 
+function testcase.skip_stale_event_of_reused_fd()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+
+    -- close the fd and reuse it for another socket before consuming
+    local fd = Reader:fd()
+    assert(ev:unwatch())
+    Reader:close()
+    Writer:close()
+    Reader, Writer = assert(socketpair())
+    local sock = Reader
+    if Writer:fd() == fd then
+        sock = Writer
+    end
+    assert.equal(sock:fd(), fd)
+    local ev2 = ep:new_event()
+    assert(ev2:as_read(fd))
+
+    -- test that the stale event is not delivered to the new event
+    assert.is_nil(ep:consume())
+    assert.equal(ep:stats().skipped, 1)
+end
+
+function testcase.fairness()
+    local ep = assert(epoll.new())
+    local sock1, sock2 = assert(socketpair())
+    local ev1 = ep:new_event()
+    local ev2 = ep:new_event()
+    ev1:as_edge()
+    ev2:as_edge()
+    assert(ev1:as_read(Reader:fd()))
+    assert(ev2:as_read(sock1:fd()))
+    assert(Writer:write('test'))
+    assert(sock2:write('test'))
+
+    -- test that set the fairness controls
+    assert(ep:set_fairness({
+        rotate = true,
+        quota = {
+            read = 1,
+        },
+    }))
+    assert.equal(ep:get_fairness(), {
+        rotate = true,
+        budget = 0,
+        quota = {
+            read = 1,
+            write = 0,
+            trigger = 0,
+            duplex = 0,
+        },
+    })
+
+    -- test that the events over the quota are deferred to the next wait
+    assert.equal(assert(ep:wait(0.1)), 2)
+    local oev = assert(ep:consume())
+    assert.is_nil(ep:consume())
+    assert.equal(assert(ep:wait(1)), 1)
+    assert.equal(assert(ep:consume()), oev == ev1 and ev2 or ev1)
+    assert.is_nil(ep:consume())
+    assert.equal(assert(ep:wait(0.01)), 0)
+
+    -- test that the budget limits the number of events of each wait
+    assert(ep:set_fairness({
+        budget = 1,
+    }))
+    assert(ev1:revert())
+    assert(ev2:revert())
+    assert(ev1:as_read(Reader:fd()))
+    assert(ev2:as_write(Writer:fd()))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert(ep:consume())
+    assert.is_nil(ep:consume())
+    sock1:close()
+    sock2:close()
+
+    -- test that throws an error if the budget is out of range
+    local err = assert.throws(ep.set_fairness, ep, {
+        budget = -1,
+    })
+    assert.match(err, 'budget must be in range')
+end
+
+function testcase.priority()
+    local ep = assert(epoll.new())
+    local ev1 = ep:new_event()
+    local ev2 = ep:new_event()
+    assert(Writer:write('test'))
+    assert(ev1:as_read(Reader:fd()))
+    assert(ev2:as_write(Writer:fd()))
+
+    -- test that the event of the higher priority is consumed first
+    assert.equal(ev2:priority(3), 0)
+    assert.equal(ev2:priority(), 3)
+    assert.equal(assert(ep:wait(0.1)), 2)
+    assert.equal(ep:consume(), ev2)
+    assert.equal(ep:consume(), ev1)
+    assert.is_nil(ep:consume())
+
+    assert.equal(ev1:priority(2), 0)
+    assert.equal(ev2:priority(0), 3)
+    assert.equal(assert(ep:wait(0.1)), 2)
+    assert.equal(ep:consume(), ev1)
+    assert.equal(ep:consume(), ev2)
+    assert.is_nil(ep:consume())
+
+    -- test that the events carried over by the quota are partitioned together
+    -- with the new events
+    local sock1, sock2 = assert(socketpair())
+    assert(ev1:revert())
+    assert(ev2:revert())
+    ev1:as_edge()
+    ev2:as_edge()
+    assert(ev1:as_read(Reader:fd()))
+    assert(ev2:as_read(sock1:fd()))
+    assert(ev1:priority(0))
+    assert(sock2:write('test'))
+    assert(ep:set_fairness({
+        quota = {
+            read = 1,
+        },
+    }))
+    assert.equal(assert(ep:wait(0.1)), 2)
+    local oev = assert(ep:consume())
+    assert.is_nil(ep:consume())
+    local ev3 = ep:new_event()
+    assert(ev3:as_write(Writer:fd()))
+    assert(ev3:priority(3))
+    assert.equal(assert(ep:wait(0.1)), 2)
+    assert.equal(ep:consume(), ev3)
+    assert.equal(ep:consume(), oev == ev1 and ev2 or ev1)
+    assert.is_nil(ep:consume())
+    sock1:close()
+    sock2:close()
+
+    -- test that throws an error if the priority is out of range
+    local err = assert.throws(ev1.priority, ev1, 4)
+    assert.match(err, 'priority must be in range 0 to 3')
+end
+
+function testcase.idle_timeout()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd(), 'idle'))
+    assert(ev:set_idle_timeout(0.05))
+
+    -- test that the expiration of the idle timeout is consumed as ETIMEDOUT
+    assert.equal(assert(ep:wait(1)), 1)
+    local oev, udata, disabled, eof, err, errnum = ep:consume()
+    assert.equal(oev, ev)
+    assert.equal(udata, 'idle')
+    assert.is_nil(disabled)
+    assert.is_nil(eof)
+    assert.equal(err, errno.ETIMEDOUT.message)
+    assert.equal(errnum, errno.ETIMEDOUT.code)
+    assert.is_true(ev:is_enabled())
+    assert.equal(ep:stats().drain_read, 1)
+
+    -- test that the activity extends the idle timeout
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(1)), 1)
+    oev, udata, disabled, eof, err = ep:consume()
+    assert.equal(oev, ev)
+    assert.is_nil(err)
+    Reader:read()
+
+    -- test that the idle timeout is disabled by zero
+    assert(ev:set_idle_timeout(0))
+    assert.equal(assert(ep:wait(0.1)), 0)
+
+    -- test that the expiration is reported even if the event is pending for
+    -- the timeout of ev:await()
+    local co = coroutine.create(function()
+        return ev:await(0.01)
+    end)
+    assert(coroutine.resume(co))
+    assert(ev:set_idle_timeout(0.01))
+    sleep(0.05)
+    assert(ep:wait(1))
+    oev, udata, disabled, eof, err, errnum = ep:consume()
+    assert.equal(oev, ev)
+    assert.equal(errnum, errno.ETIMEDOUT.code)
+end
+
 function testcase.consume()
     local ep = assert(epoll.new())
     local ev = ep:new_event()
@@ -158,6 +1087,48 @@ function testcase.consume()
     assert.is_nil(oev)
 end
 
+function testcase.dispatch()
+    local ep = assert(epoll.new())
+    local ev1 = ep:new_event()
+    local ev2 = ep:new_event()
+    assert(Writer:write('test'))
+    assert(ev1:as_read(Reader:fd(), 'read'))
+    assert(ev2:as_write(Writer:fd(), 'write'))
+
+    -- test that call function for each occurred event
+    assert.equal(assert(ep:wait()), 2)
+    local events = {}
+    local n = ep:dispatch(function(ev, udata, disabled, eof, err, errno)
+        events[udata] = ev
+        assert.is_nil(disabled)
+        assert.is_nil(eof)
+        assert.is_nil(err)
+        assert.is_nil(errno)
+    end)
+    assert.equal(n, 2)
+    assert.equal(events, {
+        read = ev1,
+        write = ev2,
+    })
+
+    -- test that return 0 if consumed all events
+    assert.equal(ep:dispatch(function()
+        error('should not be called')
+    end), 0)
+
+    -- test that consume events up to max
+    assert.equal(assert(ep:wait()), 2)
+    n = ep:dispatch(function()
+    end, 1)
+    assert.equal(n, 1)
+    assert(ep:consume())
+    assert.is_nil(ep:consume())
+
+    -- test that throws an error if fn is not function
+    local err = assert.throws(ep.dispatch, ep, 'invalid')
+    assert.match(err, 'function expected')
+end
+
 function testcase.eof_event_will_be_disabled_in_consume()
     local ep = assert(epoll.new())
     assert(Writer:write('test'))
@@ -225,5 +225,95 @@ function testcase.getinfo()
         ev:getinfo('invalid')
     end)
     assert.match(err, 'invalid option')
+
+    -- test that fill the specified table in place
+    local info = {
+        foo = 'bar',
+        data = 1,
+    }
+    assert.equal(ev:getinfo('registered', info), info)
+    assert.equal(info, {
+        foo = 'bar',
+        ident = Reader:fd(),
+    })
+
+    -- test that throws an error if info is not a table
+    err = assert.throws(ev.getinfo, ev, 'registered', 'foo')
+    assert.match(err, 'table expected')
+end
+
+-- returns true if the bit is set in the bitmask without the bitwise operators
+-- for the compatibility with lua 5.1
+local function hasbit(mask, bit)
+    return mask % (bit * 2) >= bit
+end
+
+function testcase.events_revents()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_read(Reader:fd()))
+
+    -- test that get the registered events
+    assert.is_true(hasbit(ev:events(), epoll.EPOLLIN))
+    assert.is_false(hasbit(ev:events(), epoll.EPOLLOUT))
+
+    -- test that get the occurred events
+    assert.equal(ev:revents(), 0)
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), ev)
+    assert.is_true(hasbit(ev:revents(), epoll.EPOLLIN))
+    assert.is_false(hasbit(ev:revents(), epoll.EPOLLHUP))
+
+    -- test that distinguish the hang up from the readable event
+    Writer:close()
+    Writer = nil
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), ev)
+    assert.is_true(hasbit(ev:revents(), epoll.EPOLLHUP))
 end
 
+function testcase.rearm()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_oneshot())
+    assert(ev:as_read(Reader:fd(), 'ctx'))
+
+    -- test that oneshot event is disarmed after it is consumed
+    assert(Writer:write('test'))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    local oev, udata, disabled = assert(ep:consume())
+    assert.equal(oev, ev)
+    assert.equal(udata, 'ctx')
+    assert.is_true(disabled)
+    assert.is_false(ev:is_enabled())
+    assert.equal(#ep, 0)
+    assert.equal(assert(ep:wait(0.01)), 0)
+
+    -- test that re-arm the disarmed event
+    assert.is_true(ev:rearm())
+    assert.is_true(ev:is_enabled())
+    assert.equal(#ep, 1)
+    assert.equal(assert(ep:wait(0.1)), 1)
+    oev = assert(ep:consume())
+    assert.equal(oev, ev)
+
+    -- test that return false if event is already watched
+    assert.is_true(ev:rearm())
+    assert.is_false(ev:rearm())
+
+    -- test that other event can take over the disarmed registration
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert(ep:consume())
+    local ev2 = ep:new_event()
+    assert(ev2:as_read(Reader:fd()))
+    assert.equal(assert(ep:wait(0.1)), 1)
+    oev = assert(ep:consume())
+    assert.equal(oev, ev2)
+
+    -- test that disarmed event cannot be re-armed while other event is watched
+    local ok, err, errnum = ev:rearm()
+    assert.is_false(ok)
+    assert.equal(err, errno.EEXIST.message)
+    assert.equal(errnum, errno.EEXIST.code)
+end
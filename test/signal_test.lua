@@ -222,3 +222,83 @@ function testcase.getinfo()
     assert.match(err, 'invalid option')
 end
 
+function testcase.multiple_signals()
+    local ep = assert(epoll.new())
+    local ev1 = ep:new_event()
+    local ev2 = ep:new_event()
+    local ev3 = ep:new_event()
+    assert(ev1:as_signal(signal.SIGUSR1, 'SIGUSR1'))
+    assert(ev2:as_signal(signal.SIGUSR2, 'SIGUSR2'))
+    assert(ev3:as_signal(signal.SIGHUP, 'SIGHUP'))
+    assert.equal(#ep, 3)
+    assert(signal.block(signal.SIGUSR1))
+    assert(signal.block(signal.SIGUSR2))
+    assert(signal.block(signal.SIGHUP))
+
+    -- test that received signals are reported through a single signalfd
+    local pid = getpid()
+    local p = assert(fork())
+    if p:is_child() then
+        assert(signal.kill(signal.SIGUSR1, pid))
+        assert(signal.kill(signal.SIGUSR2, pid))
+        return
+    end
+    sleep(0.1)
+    local nevt = assert(ep:wait())
+    assert.equal(nevt, 2)
+    local udata = {}
+    for _ = 1, nevt do
+        local oev, ctx = assert(ep:consume())
+        assert.not_equal(oev, ev3)
+        udata[ctx] = true
+    end
+    assert.equal(udata, {
+        SIGUSR1 = true,
+        SIGUSR2 = true,
+    })
+    assert.is_nil(ep:consume())
+
+    -- test that unwatched signal is not reported
+    assert(ev1:unwatch())
+    p = assert(fork())
+    if p:is_child() then
+        assert(signal.kill(signal.SIGUSR1, pid))
+        assert(signal.kill(signal.SIGHUP, pid))
+        return
+    end
+    sleep(0.1)
+    nevt = assert(ep:wait())
+    assert.equal(nevt, 1)
+    local oev = assert(ep:consume())
+    assert.equal(oev, ev3)
+
+    -- test that pending signal is reported after re-watching
+    assert(ev1:watch())
+    nevt = assert(ep:wait())
+    assert.equal(nevt, 1)
+    oev = assert(ep:consume())
+    assert.equal(oev, ev1)
+end
+
+function testcase.getinfo_siginfo()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_signal(signal.SIGUSR2))
+    assert(signal.block(signal.SIGUSR2))
+
+    -- test that siginfo of the received signal is reported
+    local pid = getpid()
+    local p = assert(fork())
+    if p:is_child() then
+        assert(signal.kill(signal.SIGUSR2, pid))
+        return
+    end
+    assert.equal(assert(ep:wait()), 1)
+    assert.equal(ep:consume(), ev)
+    local info = ev:getinfo('occurred')
+    assert.equal(info.data, 1)
+    assert.greater(info.pid, 0)
+    assert.not_equal(info.pid, pid)
+    assert.is_int(info.status)
+    assert.is_int(info.code)
+end
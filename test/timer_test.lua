@@ -1,4 +1,5 @@
 local testcase = require('testcase')
+local sleep = require('testcase.timer').sleep
 local epoll = require('epoll')
 local errno = require('errno')
 
@@ -208,3 +209,76 @@ function testcase.getinfo()
     assert.match(err, 'invalid option')
 end
 
+function testcase.multiple_timers()
+    local ep = assert(epoll.new())
+    local ev1 = ep:new_event()
+    local ev2 = ep:new_event()
+    local ev3 = ep:new_event()
+    assert(ev1:as_timer(1, 0.01, 'timer1'))
+    assert(ev2:as_timer(2, 0.01, 'timer2'))
+    assert(ev3:as_timer(3, 0.5, 'timer3'))
+    assert.equal(#ep, 3)
+
+    -- test that expired timers are reported through a single wakeup
+    sleep(0.05)
+    local nevt = assert(ep:wait())
+    assert.equal(nevt, 2)
+    local udata = {}
+    for _ = 1, nevt do
+        local oev, ctx = assert(ep:consume())
+        assert.not_equal(oev, ev3)
+        udata[ctx] = true
+    end
+    assert.equal(udata, {
+        timer1 = true,
+        timer2 = true,
+    })
+    assert.is_nil(ep:consume())
+
+    -- test that unwatched timer is not reported
+    assert(ev1:unwatch())
+    nevt = assert(ep:wait())
+    assert.equal(nevt, 1)
+    local oev = assert(ep:consume())
+    assert.equal(oev, ev2)
+end
+
+function testcase.oneshot_timer()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_oneshot())
+    assert(ev:as_timer(1, 0.01))
+
+    -- test that oneshot timer is disabled after it is consumed
+    assert.equal(assert(ep:wait()), 1)
+    local oev, _, disabled = assert(ep:consume())
+    assert.equal(oev, ev)
+    assert.is_true(disabled)
+    assert.is_false(ev:is_enabled())
+    assert.equal(#ep, 0)
+
+    -- test that oneshot timer can be watched again
+    assert(ev:watch())
+    assert.equal(assert(ep:wait()), 1)
+    oev = assert(ep:consume())
+    assert.equal(oev, ev)
+end
+
+function testcase.getinfo_expirations()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_timer(1, 0.01))
+
+    -- test that the number of missed expirations is reported
+    sleep(0.055)
+    assert.equal(assert(ep:wait()), 1)
+    assert.equal(ep:consume(), ev)
+    local info = ev:getinfo('occurred')
+    assert.greater_or_equal(info.data, 5)
+
+    -- test that the number of expirations is reset after consumed
+    assert.equal(assert(ep:wait()), 1)
+    assert.equal(ep:consume(), ev)
+    info = ev:getinfo('occurred')
+    assert.equal(info.data, 1)
+end
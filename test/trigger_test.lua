@@ -228,6 +228,25 @@ function testcase.trigger_counter_mode_multiple()
     assert.equal(nevt, 0)
 end
 
+function testcase.trigger_after_drain()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_trigger())
+    local handle = ev:handle()
+
+    for _ = 1, 3 do
+        -- test that the signal after the event is drained wakes the loop again
+        assert(ev:trigger())
+        assert.equal(assert(ep:wait(0.1)), 1)
+        assert.equal(ep:consume(), ev)
+        assert.equal(ev:getinfo('occurred').data, 1)
+        assert.equal(ev:handle(), handle)
+    end
+
+    -- test that the event does not fire without the signal
+    assert.equal(assert(ep:wait(0)), 0)
+end
+
 function testcase.trigger_semaphore_mode()
     local ep = assert(epoll.new())
     local ev = ep:new_event()
@@ -340,3 +359,37 @@ function testcase.trigger_returns_error_when_unwatched()
     assert.equal(err, errno.EINPROGRESS.message)
     assert.equal(errnum, errno.EINPROGRESS.code)
 end
+
+function testcase.getinfo_counter()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_trigger())
+
+    -- test that the counter value of eventfd is reported
+    assert(ev:trigger())
+    assert(ev:trigger())
+    assert(ev:trigger())
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), ev)
+    assert.equal(ev:getinfo('occurred').data, 3)
+
+    -- test that the data of registered event is not reported
+    assert.is_nil(ev:getinfo('registered').data)
+end
+
+function testcase.handle()
+    local ep = assert(epoll.new())
+    local ev = ep:new_event()
+    assert(ev:as_trigger())
+
+    -- test that return the handle of the trigger
+    local handle = ev:handle()
+    assert.equal(type(handle), 'userdata')
+    assert.equal(ev:handle(), handle)
+
+    -- test that the trigger still works after getting the handle
+    assert(ev:trigger())
+    assert.equal(assert(ep:wait(0.1)), 1)
+    assert.equal(ep:consume(), ev)
+    assert.equal(ev:getinfo('occurred').data, 1)
+end